@@ -0,0 +1,92 @@
+/* authors.c - Interning commit authors
+ * gitdiff contributors, 2026
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "authors.h"
+
+
+static unsigned long hash_str(const char *s)
+{
+        unsigned long h = 5381;
+
+        while (*s)
+                h = h * 33 + (unsigned char)*s++;
+        return h;
+}
+
+
+static int str_ptr_cmp(const void *a, const void *b)
+{
+        return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+
+/* v holds the n commits in index order. Names point into the commits, so the
+ * table must not outlive them.
+ */
+struct author_tab *new_author_tab(struct commit_node **v, int n)
+{
+        struct author_tab *at;
+        char **slots, *a;
+        int *slotid, *remap, nslots, i, j;
+        unsigned long h;
+
+        at = (struct author_tab*)malloc(sizeof(struct author_tab));
+        at->ids = (int*)malloc((n + 1) * sizeof(int));
+        at->names = NULL;
+        at->n = 0;
+
+        /* Open addressing, kept at most half full */
+        for (nslots = 64; nslots < n * 2; nslots *= 2)
+                ;
+        slots = (char**)calloc(nslots, sizeof(char*));
+        slotid = (int*)malloc(nslots * sizeof(int));
+        for (i = 0; i < n; i++) {
+                a = v[i]->author ? v[i]->author : "";
+                h = hash_str(a);
+                for (j = h & (nslots - 1); slots[j] && strcmp(slots[j], a); 
+                     j = (j + 1) & (nslots - 1))
+                        ;
+                if (!slots[j]) {
+                        slots[j] = a;
+                        slotid[j] = at->n++;
+                }
+                at->ids[i] = slotid[j];
+        }
+
+        at->names = (char**)malloc((at->n + 1) * sizeof(char*));
+        for (i = 0, j = 0; i < nslots; i++)
+                if (slots[i])
+                        at->names[j++] = slots[i];
+        qsort(at->names, at->n, sizeof(char*), str_ptr_cmp);
+
+        /* Renumber so that ids follow the sorted order */
+        remap = (int*)malloc((at->n + 1) * sizeof(int));
+        for (i = 0; i < nslots; i++) {
+                if (!slots[i])
+                        continue;
+                remap[slotid[i]] = (char**)bsearch(&slots[i], at->names, at->n,
+                                                   sizeof(char*), str_ptr_cmp)
+                                   - at->names;
+        }
+        for (i = 0; i < n; i++)
+                at->ids[i] = remap[at->ids[i]];
+
+        free(remap);
+        free(slotid);
+        free(slots);
+
+        return at;
+}
+
+
+void free_author_tab(struct author_tab *at)
+{
+        if (!at)
+                return;
+        free(at->names);
+        free(at->ids);
+        free(at);
+}
@@ -0,0 +1,27 @@
+/* authors.h - Interning commit authors
+ * gitdiff contributors, 2026
+ *
+ * Gives every distinct author a small integer id so that code counting or
+ * sorting by author compares ints instead of strings. Ids are handed out in
+ * alphabetical order, so comparing ids compares names.
+ */
+
+#ifndef AUTHORS_H
+#define AUTHORS_H
+
+#include "commitlist.h"
+
+
+struct author_tab {
+        char **names;           /* Indexed by id, sorted */
+        int n;
+        int *ids;               /* Indexed by commit_node.ind */
+};
+
+
+struct author_tab *new_author_tab(struct commit_node **v, int n);
+void free_author_tab(struct author_tab *at);
+
+
+
+#endif
@@ -0,0 +1,196 @@
+/* batch.c - Answering queries over git log's output without the curses UI
+ * gitdiff contributors, 2026
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include "batch.h"
+#include "commitlist.h"
+
+
+void init_batch_query(struct batch_query *q)
+{
+        q->nth = -1;
+        q->since = q->until = -1;
+        q->match = NULL;
+        q->limit = -1;
+        q->format = BATCH_TSV;
+}
+
+
+/* Dates on the command line are "YYYY-MM-DD" or "YYYY-MM-DD HH:MM:SS", UTC.
+ * A date on its own is the start of the day, or its last second if end is
+ * set, so that an upper bound takes in the whole day.
+ */
+int parse_query_date(const char *s, time_t *t, int end)
+{
+        struct tm tm;
+        char *p;
+
+        memset(&tm, 0, sizeof(tm));
+        if (!(p = strptime(s, "%Y-%m-%d", &tm)))
+                return 0;
+        if (!*p && end) {
+                tm.tm_hour = 23;
+                tm.tm_min = tm.tm_sec = 59;
+        } else if (*p && !(p = strptime(p, " %H:%M:%S", &tm))) {
+                return 0;
+        }
+        if (*p)
+                return 0;
+        *t = timegm(&tm);
+
+        return 1;
+}
+
+
+/* Counts and indexes are whole numbers from 0 to INT_MAX */
+int parse_query_count(const char *s, int *n)
+{
+        char *end;
+        long v;
+
+        errno = 0;
+        v = strtol(s, &end, 10);
+        if (end == s || *end || errno || v < 0 || v > INT_MAX)
+                return 0;
+        *n = v;
+
+        return 1;
+}
+
+
+int parse_batch_format(const char *s, int *format)
+{
+        if (!strcmp(s, "tsv"))
+                *format = BATCH_TSV;
+        else if (!strcmp(s, "json"))
+                *format = BATCH_JSON;
+        else if (!strcmp(s, "range"))
+                *format = BATCH_RANGE;
+        else
+                return 0;
+
+        return 1;
+}
+
+
+static int query_matches(struct batch_query *q, struct commit_node *n)
+{
+        time_t t;
+
+        if (q->nth >= 0 && n->ind != q->nth)
+                return 0;
+        if (q->since >= 0 || q->until >= 0) {
+                t = commit_time(n->date);
+                if (t < 0 || (q->since >= 0 && t < q->since) 
+                    || (q->until >= 0 && t > q->until))
+                        return 0;
+        }
+        if (q->match && !((n->author && strstr(n->author, q->match)) 
+                          || (commit_comment(n) 
+                              && strstr(commit_comment(n), q->match))))
+                return 0;
+
+        return 1;
+}
+
+
+static void put_tsv_field(const char *s, FILE *out)
+{
+        for (; s && *s; s++)
+                putc((*s == '\t' || *s == '\n') ? ' ' : *s, out);
+}
+
+
+static void put_json_string(const char *s, FILE *out)
+{
+        putc('"', out);
+        for (; s && *s; s++) {
+                switch (*s) {
+                case '"':
+                case '\\':
+                        putc('\\', out);
+                        putc(*s, out);
+                        break;
+                case '\n':
+                        fputs("\\n", out);
+                        break;
+                case '\t':
+                        fputs("\\t", out);
+                        break;
+                default:
+                        if ((unsigned char)*s < 0x20)
+                                fprintf(out, "\\u%04x", *s);
+                        else
+                                putc(*s, out);
+                }
+        }
+        putc('"', out);
+}
+
+
+static void write_record(struct batch_query *q, struct commit_node *n, 
+                         FILE *out)
+{
+        char hex[COMMIT_HEX_MAX_SIZE + 1];
+
+        hash_to_hex(n->hash, n->hashlen, hex);
+        if (q->format == BATCH_JSON) {
+                fprintf(out, "{\"ind\":%d,\"hash\":\"%s\",\"date\":", 
+                        n->ind, hex);
+                put_json_string(n->date, out);
+                fputs(",\"author\":", out);
+                put_json_string(n->author, out);
+                fputs(",\"comment\":", out);
+                put_json_string(commit_comment(n), out);
+                fputs("}\n", out);
+        } else {
+                fprintf(out, "%d\t%s\t", n->ind, hex);
+                put_tsv_field(n->date, out);
+                putc('\t', out);
+                put_tsv_field(n->author, out);
+                putc('\t', out);
+                put_tsv_field(commit_comment(n), out);
+                putc('\n', out);
+        }
+}
+
+
+/* Streams the commits in from in, writing the ones that answer the query to
+ * out. In range mode only the newest and oldest matches are kept and the
+ * result is a single "NEWEST --not OLDEST^@" line of git log arguments. That
+ * takes in the oldest match's own change, and, unlike OLDEST^..NEWEST, still
+ * works when the oldest match is a root commit with no parent to name.
+ * Returns the number of matches.
+ */
+int run_batch(struct batch_query *q, FILE *in, FILE *out)
+{
+        char from[COMMIT_HEX_MAX_SIZE + 1], to[COMMIT_HEX_MAX_SIZE + 1];
+        struct commit_node *n;
+        int ind, found;
+
+        found = 0;
+        for (ind = 0; (q->limit < 0 || found < q->limit)
+                      && (q->nth < 0 || ind <= q->nth)
+                      && (n = parse_commit(ind, in)); ind++) {
+                if (query_matches(q, n)) {
+                        if (q->format != BATCH_RANGE)
+                                write_record(q, n, out);
+                        else if (!found)
+                                hash_to_hex(n->hash, n->hashlen, to);
+                        if (q->format == BATCH_RANGE)
+                                hash_to_hex(n->hash, n->hashlen, from);
+                        found++;
+                }
+                free_commit_list(&n);
+        }
+        if (q->format == BATCH_RANGE && found)
+                fprintf(out, "%s --not %s^@\n", to, from);
+        fflush(out);
+
+        return found;
+}
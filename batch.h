@@ -0,0 +1,39 @@
+/* batch.h - Answering queries over git log's output without the curses UI
+ * gitdiff contributors, 2026
+ *
+ * Commits are parsed, checked and written out one at a time, so memory use
+ * doesn't grow with the size of the log.
+ */
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdio.h>
+#include <time.h>
+
+
+enum {
+        BATCH_TSV,
+        BATCH_JSON,
+        BATCH_RANGE
+};
+
+
+struct batch_query {
+        int nth;                /* Only the commit at this index, or -1 */
+        time_t since, until;    /* Inclusive date bounds, -1 for none */
+        char *match;            /* Substring of author or comment, or NULL */
+        int limit;              /* Stop after this many commits, or -1 */
+        int format;
+};
+
+
+void init_batch_query(struct batch_query *q);
+int parse_query_date(const char *s, time_t *t, int end);
+int parse_query_count(const char *s, int *n);
+int parse_batch_format(const char *s, int *format);
+int run_batch(struct batch_query *q, FILE *in, FILE *out);
+
+
+
+#endif
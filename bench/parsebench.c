@@ -0,0 +1,83 @@
+/* parsebench.c - Timing the git log parsers
+ * gitdiff contributors, 2026
+ *
+ * usage: parsebench LOGFILE [MAXTHREADS]
+ *
+ * Parses LOGFILE once through stdio, the way a pipe is read, and then from
+ * memory with parse_commit_buffer() at 1, 2, 4, ... MAXTHREADS threads.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "../commitlist.h"
+
+
+static double now_sec()
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+static void report(char *name, int threads, double t, size_t bytes, int count)
+{
+        printf("%-8s %3d threads  %8.3f s  %8.1f MB/s  %d commits\n", name, 
+               threads, t, bytes / t / (1024 * 1024), count);
+}
+
+
+int main(int argc, char **argv)
+{
+        struct stat st;
+        commit_list cl;
+        FILE *f;
+        char *buf;
+        double t;
+        int fd, maxthreads, th;
+
+        if (argc < 2) {
+                fprintf(stderr, "usage: %s LOGFILE [MAXTHREADS]\n", argv[0]);
+                return 1;
+        }
+        maxthreads = (argc > 2) ? atoi(argv[2]) 
+                                : sysconf(_SC_NPROCESSORS_ONLN);
+        if ((fd = open(argv[1], O_RDONLY)) < 0 || fstat(fd, &st) < 0) {
+                perror(argv[1]);
+                return 1;
+        }
+        buf = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (buf == MAP_FAILED) {
+                perror("mmap");
+                return 1;
+        }
+        /* Fault the whole file in so the first run isn't penalized */
+        for (t = 0, th = 0; th < st.st_size; th += 4096)
+                t += buf[th];
+
+        f = fdopen(dup(fd), "r");
+        t = now_sec();
+        cl = parse_commit_list(f);
+        report("stdio", 1, now_sec() - t, st.st_size, commit_list_count(cl));
+        free_commit_list(&cl);
+        fclose(f);
+
+        for (th = 1; th <= maxthreads; th *= 2) {
+                t = now_sec();
+                cl = parse_commit_buffer(buf, st.st_size, th);
+                report("buffer", th, now_sec() - t, st.st_size, 
+                       commit_list_count(cl));
+                free_commit_list(&cl);
+        }
+        munmap(buf, st.st_size);
+        close(fd);
+
+        return 0;
+}
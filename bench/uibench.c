@@ -0,0 +1,523 @@
+/* uibench.c - Replaying keystrokes into gitdiff and timing the redraws
+ * gitdiff contributors, 2026
+ *
+ * usage: uibench [-g GITDIFF] [-n COMMITS] [-s SCRIPT] [-r ROWS] [-c COLS]
+ *                [-q QUIET_MS] [-t TIMEOUT_MS]
+ *
+ * Writes a synthetic git log of COMMITS commits, starts gitdiff on it
+ * inside a pseudo-terminal, and plays a script of keystrokes into it. After
+ * each keystroke we read the terminal until gitdiff is done with it: it has
+ * read everything sent, is back waiting in its event loop with no resize
+ * pending, and nothing has arrived for QUIET_MS. However slow a command is,
+ * its output is charged to it and not to the next keystroke. The latency is
+ * the time until the last byte of the redraw arrived. Latency percentiles
+ * and bytes written are reported per action. Startup is timed the same way,
+ * to the end of the first full frame.
+ *
+ * Whether gitdiff is back in its event loop is read from /proc/PID/syscall.
+ * Where that can't be read (no /proc, or ptrace restrictions) we fall back to
+ * waiting for the terminal to be quiet with all input read, for at least
+ * FALLBACK_QUIET_MS so that a resize's debounce is waited out. That can
+ * still cut a slow command short; raise -q to compensate. Either way, an
+ * action that isn't done within TIMEOUT_MS (say a ':' prompt waiting for a
+ * line, or Enter starting the difftool) fails the run rather than hanging
+ * it.
+ *
+ * A script has one action per line, with an optional repeat count:
+ *
+ *      keys STRING [N]         each character of STRING is a keystroke
+ *      npage [N]               Page Down
+ *      ppage [N]               Page Up
+ *      resize ROWS COLS [B [N]]
+ *                              a burst of B resizes sent back to back,
+ *                              alternating with one row and column less
+ *                              and ending at ROWS x COLS, timed as one
+ *                              action; N bursts
+ *      # comment
+ *
+ * Without -s the built-in DEFAULT_SCRIPT is played.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pty.h>
+#include <signal.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+#define MAX_ACTIONS     32
+#define MAX_LINE        256
+#define TIMEOUT_MS      60000
+#define FALLBACK_QUIET_MS       200
+
+
+static char *DEFAULT_SCRIPT =
+        "# scroll storms\n"
+        "keys j 500\n"
+        "keys k 500\n"
+        "# page jumps\n"
+        "npage 50\n"
+        "ppage 50\n"
+        "# percent jumps and the ends of the list\n"
+        "keys 192837465 10\n"
+        "keys Gg 10\n"
+        "# stats pane and orderings\n"
+        "keys s 2\n"
+        "keys tfs 5\n"
+        "keys o 8\n"
+        "# resizes\n"
+        "resize 30 100 10 5\n"
+        "resize 50 160 10 5\n"
+        "resize 24 80 1\n";
+
+
+struct action_stats {
+        char name[32];
+        double *lat;            /* ms, one per keystroke */
+        int n, size;
+        long bytes;
+};
+
+
+struct bench {
+        int fd;
+        int slave;              /* To see what gitdiff hasn't read yet */
+        pid_t pid;
+        int exited, status;
+        int quiet_ms, timeout_ms;
+        int noproc;             /* /proc/PID/syscall can't be read */
+        char failed[32];        /* The action that timed out, or "" */
+        long bytes;
+        struct action_stats acts[MAX_ACTIONS];
+        int nacts;
+};
+
+
+static double now_ms()
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+
+/* Reads gitdiff's current syscall number and third argument. Returns 1,
+ * 0 if it's running rather than in a syscall, or -1 if we can't tell.
+ */
+static int child_syscall(struct bench *b, unsigned long *nr, unsigned long *a2)
+{
+        char path[64], line[256];
+        unsigned long a0, a1;
+        FILE *f;
+        int ok;
+
+        snprintf(path, sizeof(path), "/proc/%d/syscall", (int)b->pid);
+        if (!(f = fopen(path, "r")))
+                return -1;
+        ok = (fgets(line, sizeof(line), f) != NULL);
+        fclose(f);
+        if (!ok)
+                return -1;
+        if (!strncmp(line, "running", 7))
+                return 0;
+        if (sscanf(line, "%lu %lx %lx %lx", nr, &a0, &a1, a2) != 4)
+                return -1;
+
+        return 1;
+}
+
+
+/* True when gitdiff has read all its input and its main thread is blocked
+ * in poll() with no timeout, which is its event loop with nothing to do. A
+ * timeout means a resize is waiting out its debounce. Without /proc, having
+ * read everything is all we can check; drain() has waited out quiet_ms.
+ */
+static int child_idle(struct bench *b)
+{
+        unsigned long nr, a2;
+        int queued, r;
+
+        if (ioctl(b->slave, FIONREAD, &queued) < 0 || queued > 0)
+                return 0;
+        if (b->noproc || (r = child_syscall(b, &nr, &a2)) < 0)
+                return 1;
+        if (!r)
+                return 0;
+#ifdef SYS_poll
+        if (nr == SYS_poll)
+                return (int)a2 < 0;
+#endif
+#ifdef SYS_ppoll
+        if (nr == SYS_ppoll)
+                return a2 == 0;
+#endif
+
+        return 0;
+}
+
+
+static int child_exited(struct bench *b)
+{
+        if (!b->exited && waitpid(b->pid, &b->status, WNOHANG) == b->pid)
+                b->exited = 1;
+
+        return b->exited;
+}
+
+
+/* Reads the terminal until gitdiff is idle and nothing has arrived for
+ * quiet_ms, or it has exited. *last gets the time the last byte arrived, or
+ * start if none did, and *bytes the count. Returns 0 if that took longer
+ * than timeout_ms, recording name as the action that failed.
+ */
+static int drain(struct bench *b, char *name, double start, double *last, 
+                 long *bytes)
+{
+        struct pollfd pfd;
+        char buf[65536];
+        ssize_t r;
+        int n, done;
+
+        *last = start;
+        *bytes = 0;
+        pfd.fd = b->fd;
+        pfd.events = POLLIN;
+        for (done = 0; !done; ) {
+                if (now_ms() - start > b->timeout_ms) {
+                        fprintf(stderr, "%s: gitdiff not idle after %d ms\n", 
+                                name, b->timeout_ms);
+                        snprintf(b->failed, sizeof(b->failed), "%s", name);
+                        break;
+                }
+                if ((n = poll(&pfd, 1, b->quiet_ms)) < 0 && errno != EINTR)
+                        break;
+                if (n > 0) {
+                        if ((r = read(b->fd, buf, sizeof(buf))) <= 0)
+                                break;
+                        *bytes += r;
+                        *last = now_ms();
+                } else if (n == 0) {
+                        done = child_exited(b) || child_idle(b);
+                }
+        }
+        b->bytes += *bytes;
+
+        return !b->failed[0];
+}
+
+
+static struct action_stats *get_action(struct bench *b, char *name)
+{
+        struct action_stats *a;
+        int i;
+
+        for (i = 0; i < b->nacts; i++)
+                if (!strcmp(b->acts[i].name, name))
+                        return &b->acts[i];
+        if (b->nacts == MAX_ACTIONS)
+                return NULL;
+        a = &b->acts[b->nacts++];
+        snprintf(a->name, sizeof(a->name), "%s", name);
+        a->n = 0;
+        a->size = 64;
+        a->lat = (double*)malloc(a->size * sizeof(double));
+        a->bytes = 0;
+
+        return a;
+}
+
+
+static void record(struct action_stats *a, double lat, long bytes)
+{
+        if (!a)
+                return;
+        if (a->n == a->size) {
+                a->size *= 2;
+                a->lat = (double*)realloc(a->lat, a->size * sizeof(double));
+        }
+        a->lat[a->n++] = lat;
+        a->bytes += bytes;
+}
+
+
+static void send_key(struct bench *b, char *name, const char *seq, int len)
+{
+        double start, last;
+        long bytes;
+
+        start = now_ms();
+        if (write(b->fd, seq, len) != len)
+                return;
+        if (drain(b, name, start, &last, &bytes))
+                record(get_action(b, name), last - start, bytes);
+}
+
+
+/* Changes the terminal size burst times as fast as possible, ending at
+ * rows x cols, as a window being dragged would. The kernel sends gitdiff a
+ * SIGWINCH each time; it should redraw once, after the burst.
+ */
+static void resize(struct bench *b, int rows, int cols, int burst)
+{
+        struct winsize ws;
+        double start, last;
+        long bytes;
+        char name[32];
+        int i, d;
+
+        start = now_ms();
+        for (i = 0; i < burst; i++) {
+                d = (burst - 1 - i) % 2;
+                memset(&ws, 0, sizeof(ws));
+                ws.ws_row = rows - d;
+                ws.ws_col = cols - d;
+                ioctl(b->fd, TIOCSWINSZ, &ws);
+        }
+        snprintf(name, sizeof(name), "resize %dx%d/%d", rows, cols, burst);
+        if (drain(b, name, start, &last, &bytes))
+                record(get_action(b, name), last - start, bytes);
+}
+
+
+static int run_line(struct bench *b, char *line)
+{
+        char cmd[MAX_LINE], arg[MAX_LINE], name[32];
+        int n, i, j, rows, cols, burst;
+
+        n = 1;
+        if (sscanf(line, "%s", cmd) != 1 || cmd[0] == '#')
+                return 1;
+        if (!strcmp(cmd, "keys")) {
+                if (sscanf(line, "%*s %s %d", arg, &n) < 1)
+                        return 0;
+                for (i = 0; i < n && !b->failed[0]; i++) {
+                        for (j = 0; arg[j] && !b->failed[0]; j++) {
+                                snprintf(name, sizeof(name), "key '%c'", 
+                                         arg[j]);
+                                send_key(b, name, &arg[j], 1);
+                        }
+                }
+        } else if (!strcmp(cmd, "npage") || !strcmp(cmd, "ppage")) {
+                sscanf(line, "%*s %d", &n);
+                for (i = 0; i < n && !b->failed[0]; i++)
+                        send_key(b, cmd, (cmd[0] == 'n') ? "\033[6~" 
+                                                         : "\033[5~", 4);
+        } else if (!strcmp(cmd, "resize")) {
+                burst = 1;
+                if (sscanf(line, "%*s %d %d %d %d", &rows, &cols, &burst, 
+                           &n) < 2 || burst < 1)
+                        return 0;
+                for (i = 0; i < n && !b->failed[0]; i++)
+                        resize(b, rows, cols, burst);
+        } else {
+                return 0;
+        }
+
+        return 1;
+}
+
+
+/* Something shaped like "git log" output, with a few authors that aren't
+ * plain ASCII and dates going back a few minutes to a few hours a commit
+ */
+static void write_log(FILE *f, int count)
+{
+        static char *authors[] = {
+                "Blake Mitchell <blake@example.com>",
+                "Zo\xc3\xab \xc3\x85ngstr\xc3\xb6m <zoe@example.com>",
+                "\xe9\x99\x88\xe4\xbc\x9f <chen@example.com>",
+                "A. N. Other <other@example.com>"
+        };
+        char date[64];
+        time_t t;
+        unsigned int seed;
+        int i, j;
+
+        seed = 1;
+        t = 1600000000;
+        for (i = 0; i < count; i++) {
+                t -= 60 + rand_r(&seed) % 9000;
+                strftime(date, sizeof(date), "%a %b %e %H:%M:%S %Y +0000", 
+                         gmtime(&t));
+                fprintf(f, "commit ");
+                for (j = 0; j < 5; j++)
+                        fprintf(f, "%08x", rand_r(&seed));
+                fprintf(f, "\nAuthor: %s\nDate:   %s\n\n", 
+                        authors[rand_r(&seed) % 4], date);
+                fprintf(f, "    Change number %d to the frobnicator\n", i);
+                fprintf(f, "    \n    Longer description of change %d.\n\n",
+                        i);
+        }
+}
+
+
+static int cmp_double(const void *a, const void *b)
+{
+        double x = *(const double*)a, y = *(const double*)b;
+
+        return (x < y) ? -1 : (x > y);
+}
+
+
+static double pct(double *v, int n, int p)
+{
+        int i;
+
+        i = (n * p + 99) / 100 - 1;
+        return v[(i < 0) ? 0 : i];
+}
+
+
+static void report(struct bench *b)
+{
+        struct action_stats *a;
+        int i;
+
+        printf("%-16s %7s %8s %8s %8s %8s %10s\n", "action", "count", 
+               "p50 ms", "p90 ms", "p99 ms", "max ms", "bytes/key");
+        for (i = 0; i < b->nacts; i++) {
+                a = &b->acts[i];
+                if (!a->n)
+                        continue;
+                qsort(a->lat, a->n, sizeof(double), cmp_double);
+                printf("%-16s %7d %8.2f %8.2f %8.2f %8.2f %10ld\n", a->name,
+                       a->n, pct(a->lat, a->n, 50), pct(a->lat, a->n, 90), 
+                       pct(a->lat, a->n, 99), a->lat[a->n - 1], 
+                       a->bytes / a->n);
+        }
+        printf("total bytes written to the terminal: %ld\n", b->bytes);
+}
+
+
+int main(int argc, char **argv)
+{
+        char *gitdiff, *script, logpath[] = "/tmp/uibench-XXXXXX";
+        char line[MAX_LINE], *p, *nl;
+        unsigned long nr, a2;
+        struct winsize ws;
+        struct bench b;
+        double start, last;
+        long bytes;
+        FILE *f, *sf;
+        int c, count, logfd;
+
+        gitdiff = "./gitdiff";
+        script = NULL;
+        sf = NULL;
+        count = 100000;
+        memset(&ws, 0, sizeof(ws));
+        ws.ws_row = 40;
+        ws.ws_col = 120;
+        memset(&b, 0, sizeof(b));
+        b.quiet_ms = 20;
+        b.timeout_ms = TIMEOUT_MS;
+        while ((c = getopt(argc, argv, "g:n:s:r:c:q:t:")) != -1) {
+                switch (c) {
+                case 'g': gitdiff = optarg; break;
+                case 'n': count = atoi(optarg); break;
+                case 's': script = optarg; break;
+                case 'r': ws.ws_row = atoi(optarg); break;
+                case 'c': ws.ws_col = atoi(optarg); break;
+                case 'q': b.quiet_ms = atoi(optarg); break;
+                case 't': b.timeout_ms = atoi(optarg); break;
+                default:
+                        fprintf(stderr, "usage: %s [-g GITDIFF] [-n COMMITS] "
+                                "[-s SCRIPT] [-r ROWS] [-c COLS] "
+                                "[-q QUIET_MS] [-t TIMEOUT_MS]\n", argv[0]);
+                        return 1;
+                }
+        }
+        if (script && !(sf = fopen(script, "r"))) {
+                perror(script);
+                return 1;
+        }
+
+        if ((logfd = mkstemp(logpath)) < 0 || !(f = fdopen(logfd, "w"))) {
+                perror("mkstemp");
+                return 1;
+        }
+        write_log(f, count);
+        fclose(f);
+
+        b.pid = forkpty(&b.fd, NULL, NULL, &ws);
+        if (b.pid < 0) {
+                perror("forkpty");
+                return 1;
+        }
+        if (b.pid == 0) {
+                if ((logfd = open(logpath, O_RDONLY)) < 0)
+                        _exit(127);
+                dup2(logfd, STDIN_FILENO);
+                close(logfd);
+                setenv("TERM", "xterm-256color", 1);
+                setenv("LANG", "C.UTF-8", 0);
+                execl(gitdiff, gitdiff, (char*)NULL);
+                _exit(127);
+        }
+
+        if ((b.slave = open(ptsname(b.fd), O_RDWR | O_NOCTTY)) < 0) {
+                perror("ptsname");
+                return 1;
+        }
+
+        if (child_syscall(&b, &nr, &a2) < 0) {
+                b.noproc = 1;
+                if (b.quiet_ms < FALLBACK_QUIET_MS)
+                        b.quiet_ms = FALLBACK_QUIET_MS;
+                fprintf(stderr, "can't read /proc/%d/syscall; taking %d ms "
+                        "of quiet to mean done\n", (int)b.pid, b.quiet_ms);
+        }
+
+        /* Startup: parsing plus the first full draw */
+        start = now_ms();
+        if (drain(&b, "startup", start, &last, &bytes))
+                record(get_action(&b, "startup"), last - start, bytes);
+
+        if (script) {
+                while (!b.failed[0] && fgets(line, sizeof(line), sf))
+                        if (!run_line(&b, line))
+                                fprintf(stderr, "bad script line: %s", line);
+                fclose(sf);
+        } else {
+                for (p = DEFAULT_SCRIPT; *p && !b.failed[0]; p = nl + 1) {
+                        nl = strchr(p, '\n');
+                        snprintf(line, sizeof(line), "%.*s", (int)(nl - p), p);
+                        run_line(&b, line);
+                }
+        }
+
+        /* A gitdiff that's stuck won't see the 'q' */
+        if (b.failed[0])
+                kill(b.pid, SIGKILL);
+        else if (write(b.fd, "q", 1) == 1)
+                drain(&b, "quit", now_ms(), &last, &bytes);
+        if (!b.exited && b.failed[0])
+                kill(b.pid, SIGKILL);
+        if (!b.exited)
+                waitpid(b.pid, &b.status, 0);
+        close(b.slave);
+        close(b.fd);
+        unlink(logpath);
+
+        report(&b);
+        if (b.failed[0]) {
+                fprintf(stderr, "failed: %s timed out\n", b.failed);
+                return 1;
+        }
+        if (!WIFEXITED(b.status) || WEXITSTATUS(b.status)) {
+                fprintf(stderr, "gitdiff exited abnormally (status %d)\n", 
+                        b.status);
+                return 1;
+        }
+
+        return 0;
+}
@@ -2,13 +2,42 @@
  * Blake Mitchell, 2012
  */
 
+#define _GNU_SOURCE
 #include <string.h>
 #include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "commitlist.h"
+#include "parallel.h"
 
 #define MAX_LBUF_SIZE           512
 #define MAX_COMMENT_SIZE        2046
 
+/* Input is cut into about this many chunks per thread so that a thread that
+ * draws a run of big commits doesn't hold the others up at the end
+ */
+#define CHUNKS_PER_THREAD       4
+#define MIN_CHUNK_SIZE          (256 * 1024)
+
+
+struct parse_chunk {
+        const char *buf;
+        size_t len;
+        struct commit_node *head, *tail;
+        int count, ind;
+        struct comment_store *cs;
+        unsigned int cbase;
+};
+
+
+struct parse_job {
+        struct parse_chunk *chunks;
+        int nchunks;
+        int next;
+        int renumber;
+        struct comment_store *cs;
+};
+
 
 static char *COMMIT_TOKEN = "commit ";
 static char *AUTHOR_TOKEN = "Author: ";
@@ -18,13 +47,16 @@ static char *COMMENT_TOKEN = "    ";
 
 
 struct commit_node* new_commit_node(int ind, struct commit_node *prev, 
-                                    struct commit_node *next)
+                                    struct commit_node *next, int hashlen)
 {
       struct commit_node *n;
 
-      n = (struct commit_node*)malloc(sizeof(struct commit_node));
-      memset(n->hash, '\0', COMMIT_HASH_SIZE);
+      n = (struct commit_node*)malloc(sizeof(struct commit_node) + hashlen);
+      memset(n->hash, '\0', hashlen);
+      n->hashlen = hashlen;
+      n->flags = 0;
       n->ind = ind;
+      n->cref = 0;
       n->author = NULL;
       n->date = NULL;
       n->comment = NULL;
@@ -98,17 +130,21 @@ int parse_comment(struct commit_node *cn, char *lbuf, FILE *f)
 }
 
 
-int parse_commit(struct commit_node* n, FILE *f)
+/* Returns the newly parsed commit, or NULL when there are no more */
+struct commit_node *parse_commit(int ind, FILE *f)
 {
         char lbuf[MAX_LBUF_SIZE];
-
-        fgets(lbuf, MAX_LBUF_SIZE, f);
-        if (begins_with(lbuf, COMMIT_TOKEN)) 
-               memcpy(n->hash, lbuf + strlen(COMMIT_TOKEN), COMMIT_HASH_SIZE);
-        else
-               return 0;
-        while (strcmp(fgets(lbuf, MAX_LBUF_SIZE, f), "")
-               &&  strcmp(lbuf, "\n")) 
+        unsigned char hash[COMMIT_HASH_MAX_SIZE];
+        struct commit_node *n;
+        int hlen;
+
+        if (!begins_with(fgets(lbuf, MAX_LBUF_SIZE, f), COMMIT_TOKEN))
+               return NULL;
+        hlen = hex_to_hash(lbuf + strlen(COMMIT_TOKEN), hash, 
+                           COMMIT_HASH_MAX_SIZE) / 2;
+        n = new_commit_node(ind, NULL, NULL, hlen);
+        memcpy(n->hash, hash, hlen);
+        while (fgets(lbuf, MAX_LBUF_SIZE, f) && strcmp(lbuf, "\n")) 
         {
                 if (begins_with(lbuf, AUTHOR_TOKEN))
                         n->author = new_str_after_token(lbuf, AUTHOR_TOKEN);
@@ -118,44 +154,248 @@ int parse_commit(struct commit_node* n, FILE *f)
         }
         parse_comment(n, lbuf, f);
 
-        return 1;
+        return n;
+}
+
+
+/* Moves n's comment into cs */
+static void pack_comment(struct comment_store *cs, struct commit_node *n)
+{
+        if (!cs || !n->comment)
+                return;
+        n->cref = add_comment(cs, n->comment);
+        free(n->comment);
+        n->cstore = cs;
+        n->flags |= CN_PACKED;
+        cs->live++;
 }
 
 
+/* Comments are packed into a comment store of the list's own, which goes
+ * away with the last of its commits
+ */
 commit_list parse_commit_list(FILE *f)
 {
-        struct commit_node *root, *n;
+        struct commit_node *root, *last, *n;
+        struct comment_store *cs;
         int ind = 0;
 
-        root = NULL;
-        n = new_commit_node(ind++, NULL, NULL);
-        while (parse_commit(n, f) == 1) {
+        root = last = NULL;
+        cs = new_comment_store();
+        while ((n = parse_commit(ind++, f))) {
+                pack_comment(cs, n);
                 if (!root) 
                         root = n;
-                if (n->prev)
-                        n->prev->next = n;
-                n = new_commit_node(ind++, n, NULL);
+                n->prev = last;
+                if (last)
+                        last->next = n;
+                last = n;
         }
-        if (n->prev)
-                n->prev->next = NULL;
-        free_commit_list(&n); 
+        seal_comment_store(cs);
+        if (!cs->live)
+                free_comment_store(cs);
 
         return root;
 }
 
 
+/* Parses the commits in buf[0..len), which must start at a "commit " line.
+ * The first commit gets index ind; the last node and the number of commits
+ * are handed back through tail and count. Comments go into cs, if given.
+ */
+commit_list parse_commit_chunk(const char *buf, size_t len, int ind,
+                               struct commit_node **tail, int *count,
+                               struct comment_store *cs)
+{
+        struct commit_node *root, *last, *n;
+        FILE *f;
+        int i;
+
+        root = last = NULL;
+        i = ind;
+        if (len && (f = fmemopen((void*)buf, len, "r"))) {
+                while ((n = parse_commit(i, f))) {
+                        pack_comment(cs, n);
+                        if (!root)
+                                root = n;
+                        n->prev = last;
+                        if (last)
+                                last->next = n;
+                        last = n;
+                        i++;
+                }
+                fclose(f);
+        }
+        if (tail)
+                *tail = last;
+        if (count)
+                *count = i - ind;
+
+        return root;
+}
+
+
+/* Each thread is handed a pointer to the shared job, and takes chunks off it
+ * until there are none left
+ */
+static void *parse_worker(void *arg)
+{
+        struct parse_job *job = *(struct parse_job**)arg;
+        struct parse_chunk *c;
+        struct commit_node *n;
+        int i, k;
+
+        while ((i = __sync_fetch_and_add(&job->next, 1)) < job->nchunks) {
+                c = &job->chunks[i];
+                if (job->renumber) {
+                        for (n = c->head, k = 0; k < c->count; 
+                             k++, n = n->next) {
+                                n->ind += c->ind;
+                                if (n->flags & CN_PACKED) {
+                                        n->cref += c->cbase;
+                                        n->cstore = job->cs;
+                                }
+                        }
+                } else {
+                        c->head = parse_commit_chunk(c->buf, c->len, 0, 
+                                                     &c->tail, &c->count,
+                                                     c->cs);
+                        seal_comment_store(c->cs);
+                }
+        }
+
+        return NULL;
+}
+
+
+static void run_parse_job(struct parse_job *job, int nthreads)
+{
+        struct parse_job **args;
+        int i;
+
+        job->next = 0;
+        args = (struct parse_job**)malloc(nthreads * sizeof(*args));
+        for (i = 0; i < nthreads; i++)
+                args[i] = job;
+        run_parallel(parse_worker, args, sizeof(*args), nthreads);
+        free(args);
+}
+
+
+/* Finds where the commit that follows offset off starts */
+static size_t next_commit_start(const char *buf, size_t len, size_t off)
+{
+        const char *p;
+
+        if (off >= len || !(p = memmem(buf + off, len - off, "\ncommit ", 8)))
+                return len;
+
+        return (p - buf) + 1;
+}
+
+
+/* Parses an in-memory git log using nthreads threads. The buffer is cut at
+ * commit boundaries, the pieces are parsed independently, and the resulting
+ * lists are then joined in order and renumbered.
+ */
+commit_list parse_commit_buffer(const char *buf, size_t len, int nthreads)
+{
+        struct parse_job job;
+        struct parse_chunk *c;
+        struct commit_node *root, *last;
+        size_t csize, off, end;
+        int i, ind;
+
+        if (nthreads < 1)
+                nthreads = 1;
+        csize = len / (nthreads * CHUNKS_PER_THREAD) + 1;
+        if (csize < MIN_CHUNK_SIZE)
+                csize = MIN_CHUNK_SIZE;
+        job.chunks = (struct parse_chunk*)malloc((len / csize + 1) 
+                                                 * sizeof(*job.chunks));
+        job.nchunks = 0;
+        for (off = 0; off < len; off = end) {
+                end = (len - off > csize) 
+                        ? next_commit_start(buf, len, off + csize) : len;
+                c = &job.chunks[job.nchunks++];
+                c->buf = buf + off;
+                c->len = end - off;
+                c->head = c->tail = NULL;
+                c->cs = new_comment_store();
+        }
+
+        if (nthreads > job.nchunks)
+                nthreads = job.nchunks;
+        job.renumber = 0;
+        run_parse_job(&job, nthreads);
+
+        /* Chunks' comment stores are joined into the first one */
+        root = last = NULL;
+        job.cs = job.nchunks ? job.chunks[0].cs : NULL;
+        for (ind = 0, i = 0; i < job.nchunks; i++) {
+                c = &job.chunks[i];
+                c->ind = ind;
+                ind += c->count;
+                c->cbase = i ? append_comment_store(job.cs, c->cs) : 0;
+                if (!c->head)
+                        continue;
+                if (!root)
+                        root = c->head;
+                c->head->prev = last;
+                if (last)
+                        last->next = c->head;
+                last = c->tail;
+        }
+        job.renumber = 1;
+        if (job.nchunks > 1)
+                run_parse_job(&job, nthreads);
+        if (job.cs && !job.cs->live)
+                free_comment_store(job.cs);
+        free(job.chunks);
+
+        return root;
+}
+
+
+/* Parses f in parallel when it's a regular file that can be mapped, and a
+ * commit at a time otherwise (pipes, terminals).
+ */
+commit_list parse_commit_file(FILE *f)
+{
+        struct stat st;
+        commit_list cl;
+        void *buf;
+
+        if (fstat(fileno(f), &st) < 0 || !S_ISREG(st.st_mode) 
+            || st.st_size == 0 || ftello(f) != 0)
+                return parse_commit_list(f);
+        buf = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(f), 0);
+        if (buf == MAP_FAILED)
+                return parse_commit_list(f);
+        madvise(buf, st.st_size, MADV_SEQUENTIAL);
+        cl = parse_commit_buffer((const char*)buf, st.st_size, cpu_count());
+        munmap(buf, st.st_size);
+
+        return cl;
+}
+
+
 void free_commit_list(commit_list* cl)
 {
         struct commit_node *n, *tmp;
 
         n = *cl;
         while (n) {
-                if (n->author)
+                if (n->flags & CN_PACKED) {
+                        if (!--n->cstore->live)
+                                free_comment_store(n->cstore);
+                } else if (!(n->flags & CN_SHARED)) {
+                        free(n->comment);
+                }
+                if (!(n->flags & CN_SHARED)) {
                         free(n->author);
-                if (n->date)
                         free(n->date);
-                if (n->comment)
-                        free(n->comment);
+                }
                 tmp = n->next;
                 free(n);
                 n = tmp;
@@ -164,6 +404,18 @@ void free_commit_list(commit_list* cl)
 }
 
 
+/* The comment, unpacked if need be. A packed one is only good until a few
+ * more have been read; see get_comment().
+ */
+const char *commit_comment(struct commit_node *n)
+{
+        if (n->flags & CN_PACKED)
+                return get_comment(n->cstore, n->cref);
+
+        return n->comment;
+}
+
+
 int commit_list_count(commit_list cl)
 {
         struct commit_node *n;
@@ -176,6 +428,26 @@ int commit_list_count(commit_list cl)
 }
 
 
+/* Returns the nodes in list order, for code that wants to index or split
+ * the list. The caller frees the array.
+ */
+struct commit_node **commit_list_array(commit_list cl, int *count)
+{
+        struct commit_node **v, *n;
+        int c;
+
+        c = commit_list_count(cl);
+        v = (struct commit_node**)malloc((c + 1) * sizeof(*v));
+        for (n = cl, c = 0; n; n = n->next)
+                v[c++] = n;
+        v[c] = NULL;
+        if (count)
+                *count = c;
+
+        return v;
+}
+
+
 int traverse_back(commit_list *cl, int max)
 {
         struct commit_node*ln;
@@ -226,3 +498,67 @@ int traverse_forward(commit_list *cl, int max)
 
         return i;
 }
+
+
+static int hex_val(char c)
+{
+        if (c >= '0' && c <= '9')
+                return c - '0';
+        if (c >= 'a' && c <= 'f')
+                return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F')
+                return c - 'A' + 10;
+        return -1;
+}
+
+
+/* Packs the leading hex digits of hex into hash, at most max bytes worth.
+ * Returns the number of digits consumed; an odd trailing digit ends up in the
+ * high nibble of the last byte.
+ */
+int hex_to_hash(const char *hex, unsigned char *hash, int max)
+{
+        int i, v;
+
+        for (i = 0; i < max * 2 && (v = hex_val(hex[i])) >= 0; i++) {
+                if (i % 2)
+                        hash[i / 2] |= v;
+                else
+                        hash[i / 2] = v << 4;
+        }
+
+        return i;
+}
+
+
+/* hex must have room for 2 * len + 1 chars */
+void hash_to_hex(const unsigned char *hash, int len, char *hex)
+{
+        static const char *digits = "0123456789abcdef";
+        int i;
+
+        for (i = 0; i < len; i++) {
+                *hex++ = digits[hash[i] >> 4];
+                *hex++ = digits[hash[i] & 0xf];
+        }
+        *hex = '\0';
+}
+
+
+/* Converts git's default date format, e.g. "Mon Oct 1 14:03:27 2012 -0400",
+ * to a time_t. Returns -1 if the date can't be parsed.
+ */
+time_t commit_time(const char *date)
+{
+        struct tm tm;
+        char *p;
+
+        if (!date)
+                return -1;
+        memset(&tm, 0, sizeof(tm));
+        p = strptime(date, "%a %b %d %H:%M:%S %Y %z", &tm);
+        if (!p)
+                return -1;
+
+        return timegm(&tm) - tm.tm_gmtoff;
+}
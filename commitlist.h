@@ -6,29 +6,63 @@
 #define COMMITLIST_H
 
 #include <stdio.h>
+#include <time.h>
+#include "cstore.h"
 
 
-#define COMMIT_HASH_SIZE  40
+/* Hashes are kept in binary: 20 bytes for SHA-1 repositories, 32 for
+ * SHA-256 ones. The hash is the last member of commit_node and is allocated
+ * to fit, so a SHA-1 node doesn't pay for SHA-256 space.
+ */
+#define COMMIT_HASH_SIZE        20
+#define COMMIT_HASH_MAX_SIZE    32
+#define COMMIT_HEX_MAX_SIZE     (COMMIT_HASH_MAX_SIZE * 2)
+
+/* commit_node.flags */
+#define CN_SHARED       0x01    /* Strings live in a shared index image */
+#define CN_PACKED       0x02    /* Comment is cref in cstore */
+#define CN_PIDQUEUED    0x04    /* Handed to the patch-id pool */
 
 
+/* Read comments with commit_comment(), as they may be packed */
 struct commit_node {
         int ind;
-        char hash[COMMIT_HASH_SIZE];
+        unsigned int cref;
         char *date;
         char *author;
-        char *comment;
+        union {
+                char *comment;
+                struct comment_store *cstore;
+        };
         struct commit_node *prev;
         struct commit_node *next;
+        unsigned char flags;
+        unsigned char hashlen;
+        unsigned char hash[];
 };
 
 typedef struct commit_node* commit_list;
 
 
+struct commit_node *new_commit_node(int ind, struct commit_node *prev,
+                                    struct commit_node *next, int hashlen);
+struct commit_node *parse_commit(int ind, FILE *f);
 commit_list     parse_commit_list(FILE *f);
+commit_list     parse_commit_chunk(const char *buf, size_t len, int ind,
+                                   struct commit_node **tail, int *count,
+                                   struct comment_store *cs);
+commit_list     parse_commit_buffer(const char *buf, size_t len, 
+                                    int nthreads);
+commit_list     parse_commit_file(FILE *f);
 void            free_commit_list(commit_list *cl);
+const char     *commit_comment(struct commit_node *n);
 int             commit_list_count(commit_list cl);
+struct commit_node **commit_list_array(commit_list cl, int *count);
 int             traverse_back(commit_list *cl, int max);
 int             traverse_forward(commit_list *cl, int max);
+int             hex_to_hash(const char *hex, unsigned char *hash, int max);
+time_t          commit_time(const char *date);
+void            hash_to_hex(const unsigned char *hash, int len, char *hex);
 
 
 
@@ -0,0 +1,391 @@
+/* cstore.c - Compressed storage for commit comments
+ * gitdiff contributors, 2026
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "cstore.h"
+
+/* The codec writes sequences of a token byte, literals, and a match. The
+ * token's top four bits are the literal count and the bottom four the match
+ * length less LZ_MIN_MATCH; 15 in either means more length bytes follow,
+ * each added on, until one isn't 255. The match is a 16-bit little-endian
+ * offset back into the output. The last sequence is literals only.
+ */
+#define LZ_MIN_MATCH    4
+#define LZ_HASH_BITS    12
+#define LZ_MAX_OFFSET   0xffff
+#define LZ_BOUND(n)     ((n) + (n) / 255 + 16)
+
+
+static unsigned int lz_hash(const unsigned char *p)
+{
+        unsigned int v;
+
+        memcpy(&v, p, sizeof(v));
+        return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+
+static unsigned char *lz_put_len(unsigned char *op, int len)
+{
+        for (; len >= 255; len -= 255)
+                *op++ = 255;
+        *op++ = len;
+
+        return op;
+}
+
+
+static unsigned char *lz_put_seq(unsigned char *op, const unsigned char *lit,
+                                 int nlit, int off, int mlen)
+{
+        unsigned char *tok;
+
+        tok = op++;
+        *tok = ((nlit < 15) ? nlit : 15) << 4;
+        if (nlit >= 15)
+                op = lz_put_len(op, nlit - 15);
+        memcpy(op, lit, nlit);
+        op += nlit;
+        if (mlen) {
+                *op++ = off & 0xff;
+                *op++ = off >> 8;
+                mlen -= LZ_MIN_MATCH;
+                *tok |= (mlen < 15) ? mlen : 15;
+                if (mlen >= 15)
+                        op = lz_put_len(op, mlen - 15);
+        }
+
+        return op;
+}
+
+
+/* Compresses src[0..n) into dst, which must hold LZ_BOUND(n) bytes, and
+ * returns the compressed length
+ */
+static int lz_compress(const unsigned char *src, int n, unsigned char *dst)
+{
+        int tab[1 << LZ_HASH_BITS];
+        unsigned char *op;
+        int ip, anchor, ref, len;
+        unsigned int h;
+
+        memset(tab, 0xff, sizeof(tab));
+        op = dst;
+        ip = anchor = 0;
+        while (ip + LZ_MIN_MATCH <= n) {
+                h = lz_hash(src + ip);
+                ref = tab[h];
+                tab[h] = ip;
+                if (ref < 0 || ip - ref > LZ_MAX_OFFSET
+                    || memcmp(src + ref, src + ip, LZ_MIN_MATCH)) {
+                        ip++;
+                        continue;
+                }
+                for (len = LZ_MIN_MATCH;
+                     ip + len < n && src[ref + len] == src[ip + len]; len++)
+                        ;
+                op = lz_put_seq(op, src + anchor, ip - anchor, ip - ref, len);
+                ip += len;
+                anchor = ip;
+        }
+        op = lz_put_seq(op, src + anchor, n - anchor, 0, 0);
+
+        return op - dst;
+}
+
+
+/* Returns the length of the next extended length, or -1 if src runs out */
+static int lz_get_len(const unsigned char **ip, const unsigned char *end)
+{
+        int len, c;
+
+        len = 0;
+        do {
+                if (*ip == end)
+                        return -1;
+                c = *(*ip)++;
+                len += c;
+        } while (c == 255);
+
+        return len;
+}
+
+
+/* Decompresses src[0..n) into dst, which holds max bytes. Returns the
+ * decompressed length, or -1 if src is damaged.
+ */
+static int lz_decompress(const unsigned char *src, int n, unsigned char *dst,
+                         int max)
+{
+        const unsigned char *ip, *end;
+        unsigned char *op, *oend;
+        int tok, lit, len, off, x;
+
+        ip = src;
+        end = src + n;
+        op = dst;
+        oend = dst + max;
+        while (ip < end) {
+                tok = *ip++;
+                lit = tok >> 4;
+                if (lit == 15) {
+                        if ((x = lz_get_len(&ip, end)) < 0)
+                                return -1;
+                        lit += x;
+                }
+                if (lit > end - ip || lit > oend - op)
+                        return -1;
+                memcpy(op, ip, lit);
+                op += lit;
+                ip += lit;
+                if (ip == end)
+                        break;
+
+                if (end - ip < 2)
+                        return -1;
+                off = ip[0] | (ip[1] << 8);
+                ip += 2;
+                len = (tok & 15) + LZ_MIN_MATCH;
+                if ((tok & 15) == 15) {
+                        if ((x = lz_get_len(&ip, end)) < 0)
+                                return -1;
+                        len += x;
+                }
+                if (off == 0 || off > op - dst || len > oend - op)
+                        return -1;
+                /* Byte at a time: the match may overlap what it copies */
+                for (; len; len--, op++)
+                        *op = op[-off];
+        }
+
+        return op - dst;
+}
+
+
+struct comment_store *new_comment_store()
+{
+        struct comment_store *cs;
+        int i;
+
+        cs = (struct comment_store*)malloc(sizeof(struct comment_store));
+        cs->blocks = NULL;
+        cs->nblocks = cs->size = 0;
+        cs->open = NULL;
+        cs->fill = 0;
+        cs->ofirst = 0;
+        cs->ooffs = NULL;
+        cs->osize = 0;
+        cs->count = 0;
+        cs->live = 0;
+        cs->packed = 0;
+        for (i = 0; i < CSTORE_CACHE_BLOCKS; i++) {
+                cs->cache[i].block = -1;
+                cs->cache[i].used = 0;
+                cs->cache[i].raw = NULL;
+        }
+        cs->clock = 0;
+
+        return cs;
+}
+
+
+void free_comment_store(struct comment_store *cs)
+{
+        int i;
+
+        if (!cs)
+                return;
+        for (i = 0; i < cs->nblocks; i++) {
+                free(cs->blocks[i].data);
+                free(cs->blocks[i].offs);
+        }
+        for (i = 0; i < CSTORE_CACHE_BLOCKS; i++)
+                free(cs->cache[i].raw);
+        free(cs->blocks);
+        free(cs->open);
+        free(cs->ooffs);
+        free(cs);
+}
+
+
+static struct cstore_block *next_block(struct comment_store *cs)
+{
+        if (cs->nblocks == cs->size) {
+                cs->size = cs->size ? cs->size * 2 : 64;
+                cs->blocks = (struct cstore_block*)realloc(cs->blocks,
+                                        cs->size * sizeof(*cs->blocks));
+        }
+
+        return &cs->blocks[cs->nblocks++];
+}
+
+
+/* Compresses the open block, if there's anything in it. Comments added
+ * afterwards start a new block.
+ */
+void seal_comment_store(struct comment_store *cs)
+{
+        struct cstore_block *b;
+        unsigned char *buf;
+        int len;
+
+        if (!cs->open)
+                return;
+        if (cs->fill) {
+                buf = (unsigned char*)malloc(LZ_BOUND(cs->fill));
+                len = lz_compress((unsigned char*)cs->open, cs->fill, buf);
+                b = next_block(cs);
+                b->raw = cs->fill;
+                b->first = cs->ofirst;
+                b->offs = (unsigned short*)realloc(cs->ooffs, 
+                                (cs->count - cs->ofirst) * sizeof(*b->offs));
+                cs->ooffs = NULL;
+                if (len < cs->fill) {
+                        b->data = (unsigned char*)realloc(buf, len);
+                        b->len = len;
+                } else {
+                        memcpy(buf, cs->open, cs->fill);
+                        b->data = (unsigned char*)realloc(buf, cs->fill);
+                        b->len = cs->fill;
+                }
+                cs->packed += b->len;
+        }
+        free(cs->open);
+        free(cs->ooffs);
+        cs->open = NULL;
+        cs->fill = 0;
+        cs->ooffs = NULL;
+        cs->osize = 0;
+}
+
+
+/* Returns the number to get s back by. Comments too long for a block are
+ * cut short.
+ */
+unsigned int add_comment(struct comment_store *cs, const char *s)
+{
+        size_t len;
+
+        len = strlen(s);
+        if (len > CSTORE_BLOCK_SIZE - 1)
+                len = CSTORE_BLOCK_SIZE - 1;
+        if (cs->open && cs->fill + len + 1 > CSTORE_BLOCK_SIZE)
+                seal_comment_store(cs);
+        if (!cs->open) {
+                cs->open = (char*)malloc(CSTORE_BLOCK_SIZE);
+                cs->ofirst = cs->count;
+        }
+        if (cs->count - cs->ofirst == cs->osize) {
+                cs->osize = cs->osize ? cs->osize * 2 : 256;
+                cs->ooffs = (unsigned short*)realloc(cs->ooffs, 
+                                cs->osize * sizeof(*cs->ooffs));
+        }
+        cs->ooffs[cs->count - cs->ofirst] = cs->fill;
+        memcpy(cs->open + cs->fill, s, len);
+        cs->open[cs->fill + len] = '\0';
+        cs->fill += len + 1;
+
+        return cs->count++;
+}
+
+
+/* Moves src's comments onto the end of dst and frees src. Returns what to
+ * add to numbers src handed out to get them from dst.
+ */
+unsigned int append_comment_store(struct comment_store *dst,
+                                  struct comment_store *src)
+{
+        unsigned int base;
+        int i;
+
+        seal_comment_store(dst);
+        seal_comment_store(src);
+        base = dst->count;
+        for (i = 0; i < src->nblocks; i++) {
+                *next_block(dst) = src->blocks[i];
+                dst->blocks[dst->nblocks - 1].first += base;
+        }
+        dst->count += src->count;
+        dst->live += src->live;
+        dst->packed += src->packed;
+        src->nblocks = 0;
+        free_comment_store(src);
+
+        return base;
+}
+
+
+/* Finds the block holding comment ref */
+static int find_block(struct comment_store *cs, unsigned int ref)
+{
+        int lo, hi, mid;
+
+        lo = 0;
+        hi = cs->nblocks - 1;
+        while (lo < hi) {
+                mid = (lo + hi + 1) / 2;
+                if (cs->blocks[mid].first <= ref)
+                        lo = mid;
+                else
+                        hi = mid - 1;
+        }
+
+        return lo;
+}
+
+
+/* The decompressed text of block b, through the cache */
+static char *load_block(struct comment_store *cs, int b)
+{
+        struct cstore_slot *s, *lru;
+        struct cstore_block *blk;
+        int i;
+
+        lru = &cs->cache[0];
+        for (i = 0; i < CSTORE_CACHE_BLOCKS; i++) {
+                s = &cs->cache[i];
+                if (s->block == b) {
+                        s->used = ++cs->clock;
+                        return s->raw;
+                }
+                if (s->used < lru->used)
+                        lru = s;
+        }
+
+        blk = &cs->blocks[b];
+        lru->block = -1;
+        if (!lru->raw)
+                lru->raw = (char*)malloc(CSTORE_BLOCK_SIZE);
+        if (blk->len == blk->raw)
+                memcpy(lru->raw, blk->data, blk->raw);
+        else if (lz_decompress(blk->data, blk->len, (unsigned char*)lru->raw,
+                               CSTORE_BLOCK_SIZE) != blk->raw)
+                return NULL;
+        lru->block = b;
+        lru->used = ++cs->clock;
+
+        return lru->raw;
+}
+
+
+/* The comment numbered ref, or NULL. It stays valid until
+ * CSTORE_CACHE_BLOCKS other blocks have been read, so callers should copy
+ * anything they mean to keep.
+ */
+const char *get_comment(struct comment_store *cs, unsigned int ref)
+{
+        const char *p;
+        int b;
+
+        if (ref >= cs->count)
+                return NULL;
+        if (cs->open && ref >= cs->ofirst)
+                return cs->open + cs->ooffs[ref - cs->ofirst];
+        b = find_block(cs, ref);
+        if (!(p = load_block(cs, b)))
+                return NULL;
+
+        return p + cs->blocks[b].offs[ref - cs->blocks[b].first];
+}
@@ -0,0 +1,72 @@
+/* cstore.h - Compressed storage for commit comments
+ * gitdiff contributors, 2026
+ *
+ * Comments are most of what a parsed history weighs, yet only the few on
+ * screen are needed at any one time. A comment store packs them end to end,
+ * NUL-terminated, into fixed-size blocks, and compresses each block as it
+ * fills with a small LZ77 codec of the LZ4 kind. Comments are then referred
+ * to by number. Reading one decompresses its block into a small cache of
+ * recently used blocks, so scrolling through the list only decompresses a
+ * block each time it moves onto a new one. Each block keeps where its
+ * comments start, so finding one in a decompressed block doesn't mean
+ * walking the ones before it.
+ *
+ * A store isn't safe to use from more than one thread at a time.
+ */
+
+#ifndef CSTORE_H
+#define CSTORE_H
+
+#include <stddef.h>
+
+/* A comment never spans two blocks, so this is also the longest comment
+ * that can be stored (less the NUL). Match offsets, and the offsets of
+ * comments within a block, are 16 bits.
+ */
+#define CSTORE_BLOCK_SIZE       (32 * 1024)
+#define CSTORE_CACHE_BLOCKS     8
+
+
+struct cstore_block {
+        unsigned char *data;
+        unsigned int len;               /* Compressed; == raw if it didn't */
+        unsigned int raw;
+        unsigned int first;             /* Number of its first comment */
+        unsigned short *offs;           /* Where each comment starts in raw */
+};
+
+
+struct cstore_slot {
+        int block;                      /* -1 when empty */
+        unsigned int used;
+        char *raw;
+};
+
+
+struct comment_store {
+        struct cstore_block *blocks;
+        int nblocks, size;
+        char *open;                     /* Block being filled, or NULL */
+        unsigned int fill;
+        unsigned int ofirst;            /* Number of its first comment */
+        unsigned short *ooffs;
+        unsigned int osize;
+        unsigned int count;             /* Comments added */
+        unsigned int live;              /* Commits still referring to it */
+        size_t packed;                  /* Compressed bytes in blocks */
+        struct cstore_slot cache[CSTORE_CACHE_BLOCKS];
+        unsigned int clock;
+};
+
+
+struct comment_store *new_comment_store();
+void free_comment_store(struct comment_store *cs);
+unsigned int add_comment(struct comment_store *cs, const char *s);
+void seal_comment_store(struct comment_store *cs);
+unsigned int append_comment_store(struct comment_store *dst,
+                                  struct comment_store *src);
+const char *get_comment(struct comment_store *cs, unsigned int ref);
+
+
+
+#endif
@@ -0,0 +1,120 @@
+/* gitcmd.c - Running git and reading its output
+ * gitdiff contributors, 2026
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include "gitcmd.h"
+
+#define MAX_GIT_ARGS    16
+
+
+/* Starts "git -C dir args..." with its stdout on the returned stream and
+ * stderr thrown away. dir may be NULL for the current directory. Safe to
+ * call from several threads: the pipe is close-on-exec from the start, so
+ * one thread's git doesn't hold another's pipe open.
+ */
+FILE *git_popen(const char *dir, char *const args[], pid_t *pid)
+{
+        char *argv[MAX_GIT_ARGS + 4];
+        int fds[2], i, n, devnull;
+        sigset_t none;
+        FILE *f;
+
+        n = 0;
+        argv[n++] = "git";
+        if (dir) {
+                argv[n++] = "-C";
+                argv[n++] = (char*)dir;
+        }
+        for (i = 0; args[i] && i < MAX_GIT_ARGS; i++)
+                argv[n++] = args[i];
+        argv[n] = NULL;
+
+        if (pipe2(fds, O_CLOEXEC) < 0)
+                return NULL;
+        if ((*pid = fork()) < 0) {
+                close(fds[0]);
+                close(fds[1]);
+                return NULL;
+        }
+        if (*pid == 0) {
+                dup2(fds[1], STDOUT_FILENO);
+                if ((devnull = open("/dev/null", O_RDWR)) >= 0) {
+                        dup2(devnull, STDIN_FILENO);
+                        dup2(devnull, STDERR_FILENO);
+                }
+                close(fds[0]);
+                close(fds[1]);
+                /* Whatever thread we were forked from may block signals */
+                sigemptyset(&none);
+                sigprocmask(SIG_SETMASK, &none, NULL);
+                execvp("git", argv);
+                _exit(127);
+        }
+        close(fds[1]);
+        if (!(f = fdopen(fds[0], "r"))) {
+                close(fds[0]);
+                git_pclose(NULL, *pid);
+        }
+
+        return f;
+}
+
+
+/* Returns git's exit status, or -1 if it didn't exit normally */
+int git_pclose(FILE *f, pid_t pid)
+{
+        int st;
+
+        if (f)
+                fclose(f);
+        while (waitpid(pid, &st, 0) < 0)
+                if (errno != EINTR)
+                        return -1;
+        return WIFEXITED(st) ? WEXITSTATUS(st) : -1;
+}
+
+
+/* Runs git for its exit status alone, ignoring its output */
+int git_status(const char *dir, char *const args[])
+{
+        FILE *f;
+        pid_t pid;
+
+        if (!(f = git_popen(dir, args, &pid)))
+                return -1;
+        while (fgetc(f) != EOF)
+                ;
+
+        return git_pclose(f, pid);
+}
+
+
+/* Runs git and keeps the first line of its output, without the newline.
+ * Returns 1 if git succeeded and printed something.
+ */
+int git_output_line(const char *dir, char *const args[], char *buf, int size)
+{
+        FILE *f;
+        pid_t pid;
+        int ok;
+        char *p;
+
+        if (!(f = git_popen(dir, args, &pid)))
+                return 0;
+        ok = (fgets(buf, size, f) != NULL);
+        while (fgetc(f) != EOF)
+                ;
+        ok = (git_pclose(f, pid) == 0) && ok;
+        if (ok && (p = strchr(buf, '\n')))
+                *p = '\0';
+
+        return ok;
+}
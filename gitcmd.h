@@ -0,0 +1,22 @@
+/* gitcmd.h - Running git and reading its output
+ * gitdiff contributors, 2026
+ *
+ * Like popen(), but git is exec'd directly instead of through the shell, so
+ * paths and revisions don't need quoting.
+ */
+
+#ifndef GITCMD_H
+#define GITCMD_H
+
+#include <stdio.h>
+#include <sys/types.h>
+
+
+FILE *git_popen(const char *dir, char *const args[], pid_t *pid);
+int git_pclose(FILE *f, pid_t pid);
+int git_status(const char *dir, char *const args[]);
+int git_output_line(const char *dir, char *const args[], char *buf, int size);
+
+
+
+#endif
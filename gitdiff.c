@@ -4,14 +4,43 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 #include <signal.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <locale.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <limits.h>
 #include "gitdiff.h"
 #include "keys.h"
+#include "batch.h"
+#include "parallel.h"
+#include "gitcmd.h"
+
+
+/* Terminals send resizes in bursts while the user drags the window, so we
+ * only relayout once they've been quiet for this long
+ */
+#define RESIZE_DEBOUNCE_MS      50
+/* While duplicates are hidden, patch-ids coming in are only acted on at a
+ * key press, and at most this often, so the list doesn't move on its own
+ */
+#define RECOLLAPSE_MS           1000
+
+
+enum {
+        MODE_UI,
+        MODE_BATCH,
+        MODE_DAEMON
+};
 
 
 static int CURSES_SCREEN = 0;
+static char *INDEX_SOCK = NULL;
+static int WINCH_PIPE[2] = { -1, -1 };
+static struct sigaction CURSES_WINCH;
 
 struct defkey {
         int c; 
@@ -29,6 +58,10 @@ struct defkey {
         /*This is actually less cumbersome than a function to add these
          * programmatically, so why not list them out */
         { 't', selto, NULL },
+        { ':', gotohash, NULL },
+        { 's', togglestats, NULL },
+        { 'o', nextorder, NULL },
+        { 'D', togglecollapse, NULL },
         { '1', perc, "10" },
         { '2', perc, "20" },
         { '3', perc, "30" },
@@ -42,20 +75,43 @@ struct defkey {
 
 
 
+void usage(char *prog);
+int parse_args(int argc, char **argv, struct batch_query *q);
 void stdin_from_tty();
+void catch_winch();
 void init_gdd(struct gd_data *gdd);
 void set_keys(struct keybindings *kb, struct defkey dk[], int size);
 void init_curses();
 void init_colors();
 void init_windows(struct gd_data *gdd);
 void init_list(struct gd_data *gdd);
+void layout_list(struct gd_data *gdd);
 void decorate_list_entry(struct gd_data *gdd, int lnum, 
                          struct commit_node* n);
 void draw_list(struct gd_data *gdd);
+void data_changed(struct gd_data *gdd);
+int view_forward(struct gd_data *gdd, struct commit_node **n, int max);
+int view_back(struct gd_data *gdd, struct commit_node **n, int max);
+struct commit_node *view_first(struct gd_data *gdd);
+int view_pos(struct gd_data *gdd, struct commit_node *n);
+int view_count(struct gd_data *gdd);
+int order_mode(struct gd_data *gdd);
+void rebuild_order(struct gd_data *gdd, int mode);
+void drop_orders(struct gd_data *gdd, int all);
+struct commit_node *shown_commit(struct gd_data *gdd, struct commit_node *n);
+static long now_ms();
+int start_patchids(struct gd_data *gdd);
+void queue_patchids(struct gd_data *gdd);
+void patchids_ready(struct gd_data *gdd, int fd);
+void watch_refs(struct gd_data *gdd);
+void refs_changed(struct gd_data *gdd, int fd);
 void draw_statbar(struct gd_data *gdd);
 void draw_towin(struct gd_data *gdd);
+void draw_stats(struct gd_data *gdd);
 void draw_fromwin(struct gd_data *gdd);
 void ev_loop(struct gd_data *gdd, struct keybindings *kb);
+int handle_key(struct gd_data *gdd, struct keybindings *kb, int ch, 
+               long *resize_at);
 void refresh_windows(struct gd_data *gdd);
 void resize_windows(struct gd_data *gdd);
 void end_curses();
@@ -64,11 +120,22 @@ void run_command(struct command *cmd, struct gd_data *gdd);
 
 
 
-main()
+int main(int argc, char **argv)
 {
         struct keybindings *keys;
         struct gd_data gddata;
         struct gd_data *gdd;
+        struct batch_query query;
+
+        switch (parse_args(argc, argv, &query)) {
+        case -1:
+                usage(argv[0]);
+                return 1;
+        case MODE_BATCH:
+                return (run_batch(&query, stdin, stdout) > 0) ? 0 : 1;
+        case MODE_DAEMON:
+                return run_index_daemon(INDEX_SOCK);
+        }
 
         gdd = &gddata;
         keys = new_keybindings();
@@ -80,6 +147,7 @@ main()
         }
 
         stdin_from_tty();
+        setlocale(LC_ALL, "");
 
         set_keys(keys, DEFAULT_KEYS, ARRYSIZE(DEFAULT_KEYS));
 
@@ -89,14 +157,109 @@ main()
         draw_statbar(gdd);
         draw_fromwin(gdd);
         draw_towin(gdd);
+        watch_refs(gdd);
         ev_loop(gdd, keys);
         end_curses();
+        free_patchid_pool(gdd->pids);
+        free_ref_watch(gdd->rw);
+        free_hash_index(gdd->hidx);
+        free_row_cache(gdd->rc);
+        free_commit_stats(gdd->stats);
+        drop_orders(gdd, 1);
         free_commit_list(&(gdd->cl));
+        detach_commit_index(&gdd->img);
         free_keybindings(keys);
         return 0;
 }
 
 
+void usage(char *prog)
+{
+        fprintf(stderr, 
+                "usage: git log | %s [-b] [-n N] [-a DATE] [-u DATE] "
+                "[-m TEXT] [-c COUNT] [-o tsv|json|range]\n"
+                "       %s -S SOCKET\n"
+                "       %s -D SOCKET\n"
+                "  -b          batch mode: print matching commits, no UI\n"
+                "  -n N        only the Nth commit (0 is the newest)\n"
+                "  -a DATE     commits on or after DATE (YYYY-MM-DD[ HH:MM:SS])\n"
+                "  -u DATE     commits on or before DATE (a day on its own is\n"
+                "              taken to its end)\n"
+                "  -m TEXT     commits whose author or comment contains TEXT\n"
+                "  -c COUNT    stop after COUNT matching commits\n"
+                "  -o FORMAT   tsv (default), json (one object per line) or\n"
+                "              range (git log arguments for the commits from\n"
+                "              the oldest match to the newest:\n"
+                "              NEWEST --not OLDEST^@)\n"
+                "Any query option implies -b.\n"
+                "  -S SOCKET   get this repository's history from the index\n"
+                "              daemon at SOCKET instead of stdin\n"
+                "  -D SOCKET   run the index daemon on SOCKET\n", 
+                prog, prog, prog);
+}
+
+
+static int bad_arg(char *prog, int opt, char *arg)
+{
+        fprintf(stderr, "%s: bad argument to -%c: '%s'\n", prog, opt, arg);
+        return -1;
+}
+
+
+/* Returns one of the MODE_s, or -1 on bad arguments */
+int parse_args(int argc, char **argv, struct batch_query *q)
+{
+        int c, mode;
+
+        init_batch_query(q);
+        mode = MODE_UI;
+        while ((c = getopt(argc, argv, "bn:a:u:m:c:o:S:D:")) != -1) {
+                switch (c) {
+                case 'S':
+                        INDEX_SOCK = optarg;
+                        continue;
+                case 'D':
+                        INDEX_SOCK = optarg;
+                        mode = MODE_DAEMON;
+                        continue;
+                case 'b':
+                        break;
+                case 'n':
+                        if (!parse_query_count(optarg, &q->nth))
+                                return bad_arg(argv[0], c, optarg);
+                        break;
+                case 'a':
+                        if (!parse_query_date(optarg, &q->since, 0))
+                                return bad_arg(argv[0], c, optarg);
+                        break;
+                case 'u':
+                        if (!parse_query_date(optarg, &q->until, 1))
+                                return bad_arg(argv[0], c, optarg);
+                        break;
+                case 'm':
+                        q->match = optarg;
+                        break;
+                case 'c':
+                        if (!parse_query_count(optarg, &q->limit))
+                                return bad_arg(argv[0], c, optarg);
+                        break;
+                case 'o':
+                        if (!parse_batch_format(optarg, &q->format))
+                                return bad_arg(argv[0], c, optarg);
+                        break;
+                default:
+                        return -1;
+                }
+                if (mode == MODE_UI)
+                        mode = MODE_BATCH;
+        }
+        if (optind < argc)
+                return -1;
+
+        return mode;
+}
+
+
 /* Since we piped in input, we must change the stdin fd back to 
  * the terminal so the user can give input to curses
  */
@@ -111,10 +274,35 @@ void stdin_from_tty()
 
 void init_gdd(struct gd_data *gdd)
 {
-        gdd->cl = parse_commit_list(stdin);
+        char cwd[PATH_MAX];
+
+        gdd->cl = NULL;
+        gdd->img.map = NULL;
+        if (INDEX_SOCK && getcwd(cwd, sizeof(cwd))) {
+                gdd->cl = attach_commit_index(INDEX_SOCK, cwd, &gdd->img);
+                if (!gdd->cl)
+                        fprintf(stderr, "No history from index daemon at %s, "
+                                "reading stdin\n", INDEX_SOCK);
+        }
+        if (!gdd->cl && !isatty(STDIN_FILENO))
+                gdd->cl = parse_commit_file(stdin);
         gdd->ccount = commit_list_count(gdd->cl);
         gdd->cto = gdd->cfrom = NULL;
-        gdd->lref = gdd->tref = gdd->fref = gdd->sref = 0;
+        gdd->hidx = NULL;
+        gdd->rc = new_row_cache();
+        gdd->stats = NULL;
+        gdd->rw = NULL;
+        gdd->order = NULL;
+        memset(gdd->orders, 0, sizeof(gdd->orders));
+        gdd->pids = NULL;
+        gdd->collapse = 0;
+        gdd->recollapse = 0;
+        gdd->collapsed_at = 0;
+        gdd->msg = NULL;
+        gdd->nevs = 0;
+        gdd->towin = gdd->fromwin = gdd->lwin = gdd->statwin = NULL;
+        gdd->stwin = NULL;
+        gdd->lref = gdd->tref = gdd->fref = gdd->sref = gdd->stref = 0;
 }
 
 
@@ -142,11 +330,46 @@ void init_curses()
                 start_color();
                 use_default_colors(); 
                 init_colors();
+                nodelay(stdscr, 1);
+                catch_winch();
                 CURSES_SCREEN = 1;
         }
 }
 
 
+static void winch_handler(int sig)
+{
+        int err;
+
+        err = errno;
+        if (CURSES_WINCH.sa_handler != SIG_DFL 
+            && CURSES_WINCH.sa_handler != SIG_IGN)
+                CURSES_WINCH.sa_handler(sig);
+        write(WINCH_PIPE[1], "", 1);
+        errno = err;
+}
+
+
+/* curses notices SIGWINCH with a handler of its own, which only has an effect
+ * the next time we call getch(). Chain ours in front of it so that ev_loop()
+ * is woken up by the pipe even when the signal doesn't land in poll().
+ */
+void catch_winch()
+{
+        struct sigaction sa;
+
+        if (pipe(WINCH_PIPE) < 0)
+                return;
+        fcntl(WINCH_PIPE[0], F_SETFL, O_NONBLOCK);
+        fcntl(WINCH_PIPE[1], F_SETFL, O_NONBLOCK);
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = winch_handler;
+        sigemptyset(&sa.sa_mask);
+        sa.sa_flags = SA_RESTART;
+        sigaction(SIGWINCH, &sa, &CURSES_WINCH);
+}
+
+
 void init_colors()
 {
         init_pair(CLR_HEADER, COLOR_YELLOW, -1);
@@ -160,6 +383,13 @@ void init_windows(struct gd_data *gdd)
 {
         int ymax, xmax, ypos;
 
+        /* Subwindows have to go before a new set is cut out of stdscr */
+        if (gdd->lwin) {
+                delwin(gdd->towin);
+                delwin(gdd->fromwin);
+                delwin(gdd->lwin);
+                delwin(gdd->statwin);
+        }
         getmaxyx(stdscr, ymax, xmax);
         ypos = 0;
         gdd->towin = subwin(stdscr, 1, 0, ypos++, 0);
@@ -174,23 +404,26 @@ void init_windows(struct gd_data *gdd)
 
 void init_list(struct gd_data *gdd)
 {
-        struct commit_node *n;
-        int ybeg, xbeg, ymax, xmax;
-        int lnum;
-
-        getbegyx(gdd->lwin, ybeg, xbeg);
-        getmaxyx(gdd->lwin, ymax, xmax);
-        
         gdd->lsel = 1;
-        gdd->lw = xmax - 2;
-        gdd->lh = ymax - 2;
-        gdd->csel = gdd->cl;
+        gdd->csel = view_first(gdd);
+        layout_list(gdd);
         draw_list(gdd);
         decorate_list_entry(gdd, gdd->lsel, gdd->csel);
         gdd->lref = 1;
 }
 
 
+/* Picks up the list window's size */
+void layout_list(struct gd_data *gdd)
+{
+        int ymax, xmax;
+
+        getmaxyx(gdd->lwin, ymax, xmax);
+        gdd->lw = xmax - 2;
+        gdd->lh = ymax - 2;
+}
+
+
 void add_labeled_text(WINDOW *w, char *lbl, char *str, int attr)
 {
         wattrset(w, A_REVERSE);
@@ -232,37 +465,493 @@ void clear_list(struct gd_data *gdd)
 }
 
 
+/* The list is walked through these so that it can be shown in another
+ * order without moving the nodes. They work like traverse_forward() and
+ * traverse_back().
+ */
+int view_forward(struct gd_data *gdd, struct commit_node **n, int max)
+{
+        if (gdd->order)
+                return order_traverse_forward(gdd->order, n, max);
+        return traverse_forward(n, max);
+}
+
+
+int view_back(struct gd_data *gdd, struct commit_node **n, int max)
+{
+        if (gdd->order)
+                return order_traverse_back(gdd->order, n, max);
+        return traverse_back(n, max);
+}
+
+
+struct commit_node *view_first(struct gd_data *gdd)
+{
+        return gdd->order ? gdd->order->v[0] : gdd->cl;
+}
+
+
+int view_count(struct gd_data *gdd)
+{
+        return gdd->order ? gdd->order->n : gdd->ccount;
+}
+
+
+int order_mode(struct gd_data *gdd)
+{
+        return gdd->order ? gdd->order->mode : ORDER_LOG;
+}
+
+
+/* Where n is in the list as shown */
+int view_pos(struct gd_data *gdd, struct commit_node *n)
+{
+        return gdd->order ? gdd->order->pos[n->ind] : n->ind;
+}
+
+
 /* draw_list uses gdd->lsel and gdd->csel to determine which items should be in
  * the list, so make sure you set them appropriately before calling this
  */
 void draw_list(struct gd_data *gdd)
 {
-        int plines, tlines, lcount, li, lbsize;
+        int plines, tlines, lcount, li;
         struct commit_node *n;
-        char *lbuf;
+        struct row_render *rr;
+        uint64_t pid;
 
         clear_list(gdd);
         tlines = gdd->lh / 2;
         plines = (gdd->lsel - 1) / 2;
         n = gdd->csel;
-        lbsize = gdd->lw + 1;
-        lbuf = (char*)malloc(lbsize);
-        lcount = traverse_back(&n, plines);
+        lcount = view_back(gdd, &n, plines);
         gdd->lsel -= (plines - lcount)*2;
         li = 1;
         for (lcount = 0; lcount < tlines && n; lcount++) {
-                memset(lbuf, '\0', lbsize);
-                snprintf(lbuf, lbsize, "%s | %s", n->date, n->author);
-                mvwaddnstr(gdd->lwin, li++, 1, lbuf, gdd->lw); 
-                mvwaddnstr(gdd->lwin, li++, 5, n->comment, gdd->lw - 4);
+                if ((rr = get_row_render(gdd->rc, n, gdd->lw))) {
+                        mvwaddstr(gdd->lwin, li, 1, rr->hdr); 
+                        mvwaddstr(gdd->lwin, li + 1, 5, rr->cmt);
+                }
+                li += 2;
+                if (gdd->pids && commit_patchid(gdd->pids, n, &pid)
+                    && patchid_count(gdd->pids, pid) > 1)
+                        mvwaddch(gdd->lwin, li - 1, 2, '=');
                 decorate_list_entry(gdd, li-2, n);
-                n = n->next;
+                if (!view_forward(gdd, &n, 1))
+                        break;
         }
         gdd->lref = 1;
-        free(lbuf);        
 } 
 
 
+/* The commits in FROM..TO, as indexes [lo, hi). An unset TO is the newest
+ * commit and an unset FROM the oldest, so with neither set it's everything.
+ */
+void selected_range(struct gd_data *gdd, int *lo, int *hi)
+{
+        int t;
+
+        *lo = gdd->cto ? gdd->cto->ind : 0;
+        *hi = gdd->cfrom ? gdd->cfrom->ind : gdd->ccount;
+        if (*hi < *lo) {
+                t = *lo;
+                *lo = *hi;
+                *hi = t;
+        }
+}
+
+
+static void day_str(int day, char *buf, int size)
+{
+        struct tm tm;
+        time_t t;
+
+        t = (time_t)day * 24 * 60 * 60;
+        gmtime_r(&t, &tm);
+        strftime(buf, size, "%Y-%m-%d", &tm);
+}
+
+
+/* Draws a histogram of the most recent periods in the range, a row each.
+ * Weeks are used when they fit, months otherwise.
+ */
+static void draw_histogram(struct gd_data *gdd, int y, int rows)
+{
+        struct commit_stats *cs = gdd->stats;
+        int first, last, weeks, w0, i, j, p, c, max, bw, *counts;
+        char lbl[32], *bar;
+
+        for (first = 0; first < cs->nday && !cs->dcount[first]; first++)
+                ;
+        for (last = cs->nday - 1; last >= first && !cs->dcount[last]; last--)
+                ;
+        if (rows < 2 || first > last)
+                return;
+        rows--;
+        w0 = (first + cs->day0 + 3) / 7;
+        weeks = ((last + cs->day0 + 3) / 7 - w0 + 1 <= rows);
+        counts = (int*)calloc(rows, sizeof(int));
+        if (weeks) {
+                for (i = first; i <= last; i++)
+                        counts[(i + cs->day0 + 3) / 7 - w0] += cs->dcount[i];
+                p = (last + cs->day0 + 3) / 7 - w0 + 1;
+        } else {
+                for (first = 0; first < cs->nmonth && !cs->mcount[first]; 
+                     first++)
+                        ;
+                for (last = cs->nmonth - 1; last > first && !cs->mcount[last];
+                     last--)
+                        ;
+                if (last - first + 1 > rows)
+                        first = last - rows + 1;
+                for (i = first; i <= last; i++)
+                        counts[i - first] = cs->mcount[i];
+                p = last - first + 1;
+        }
+        for (max = 1, i = 0; i < p; i++)
+                if (counts[i] > max)
+                        max = counts[i];
+
+        mvwaddstr(gdd->stwin, y++, 2, weeks ? "Commits per week" 
+                                            : "Commits per month");
+        bw = gdd->lw - 22;
+        bar = (char*)malloc(bw > 0 ? bw + 1 : 1);
+        for (i = p - 1; i >= 0; i--, y++) {
+                if (weeks) {
+                        day_str((w0 + i) * 7 - 3, lbl, sizeof(lbl));
+                } else {
+                        j = first + i + cs->month0;
+                        snprintf(lbl, sizeof(lbl), "%04d-%02d   ", j / 12, 
+                                 j % 12 + 1);
+                }
+                c = (bw > 0) ? (long)counts[i] * bw / max : 0;
+                memset(bar, '#', c);
+                bar[c] = '\0';
+                mvwprintw(gdd->stwin, y, 2, "%-10s %7d %s", lbl, counts[i], 
+                          bar);
+        }
+        free(bar);
+        free(counts);
+}
+
+
+void draw_stats(struct gd_data *gdd)
+{
+        static char *wdays[] = { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", 
+                                 "Sat" };
+        struct commit_stats *cs;
+        int lo, hi, y, ymax, i, n, top[8];
+        char buf[64], *name;
+
+        if (!gdd->stwin)
+                return;
+        if (!gdd->stats)
+                gdd->stats = new_commit_stats(gdd->cl);
+        cs = gdd->stats;
+        selected_range(gdd, &lo, &hi);
+        set_stats_range(cs, lo, hi);
+
+        werase(gdd->stwin);
+        box(gdd->stwin, 0, 0);
+        ymax = gdd->lh + 1;
+        y = 1;
+        mvwprintw(gdd->stwin, y++, 2, "%d commits in %s", cs->total, 
+                  (gdd->cfrom || gdd->cto) ? "FROM..TO" : "loaded history");
+
+        y++;
+        mvwaddstr(gdd->stwin, y, 2, "By weekday:");
+        for (i = 0; i < 7; i++)
+                wprintw(gdd->stwin, "  %s %d", wdays[i], cs->wday[i]);
+        y++;
+        mvwaddstr(gdd->stwin, y, 2, "Busiest days:");
+        n = stats_top(cs->dcount, cs->nday, top, 3);
+        for (i = 0; i < n; i++) {
+                day_str(top[i] + cs->day0, buf, sizeof(buf));
+                wprintw(gdd->stwin, "  %s (%d)", buf, cs->dcount[top[i]]);
+        }
+        y += 2;
+
+        if (y < ymax)
+                mvwaddstr(gdd->stwin, y++, 2, "Top authors");
+        n = stats_top(cs->acount, cs->at->n, top, ARRYSIZE(top));
+        for (i = 0; i < n && y < ymax; i++, y++) {
+                mvwprintw(gdd->stwin, y, 2, "%7d  ", cs->acount[top[i]]);
+                name = fit_width(cs->at->names[top[i]], gdd->lw - 11);
+                waddstr(gdd->stwin, name);
+                free(name);
+        }
+        y++;
+
+        draw_histogram(gdd, y, ymax - y);
+        gdd->stref = 1;
+}
+
+
+struct pid_first {
+        uint64_t id;
+        struct commit_node *n;
+};
+
+
+struct collapse {
+        struct patchid_pool *pids;
+        int lo, hi;
+        struct pid_first *t;
+        int size;
+};
+
+
+/* The newest commit in the range with the same patch-id as n, or NULL if
+ * there's no point hiding anything for n
+ */
+static struct pid_first *first_with_patchid(struct collapse *c, 
+                                            struct commit_node *n)
+{
+        uint64_t id;
+        int i;
+
+        if (n->ind < c->lo || n->ind >= c->hi 
+            || !commit_patchid(c->pids, n, &id)
+            || patchid_count(c->pids, id) < 2)
+                return NULL;
+        for (i = id & (c->size - 1); c->t[i].n && c->t[i].id != id;
+             i = (i + 1) & (c->size - 1))
+                ;
+        c->t[i].id = id;
+
+        return &c->t[i];
+}
+
+
+static int keep_uncollapsed(struct commit_node *n, void *arg)
+{
+        struct pid_first *f;
+
+        f = first_with_patchid((struct collapse*)arg, n);
+        return !f || f->n == n;
+}
+
+
+static void collapse_duplicates(struct gd_data *gdd)
+{
+        struct collapse c;
+        struct pid_first *f;
+        struct commit_node *n;
+        int i;
+
+        c.pids = gdd->pids;
+        selected_range(gdd, &c.lo, &c.hi);
+        for (c.size = 64; c.size < (c.hi - c.lo) * 2; c.size *= 2)
+                ;
+        c.t = (struct pid_first*)calloc(c.size, sizeof(*c.t));
+        for (i = 0; i < gdd->order->n; i++) {
+                n = gdd->order->v[i];
+                if ((f = first_with_patchid(&c, n)) 
+                    && (!f->n || n->ind < f->n->ind))
+                        f->n = n;
+        }
+        if ((f = first_with_patchid(&c, gdd->csel)))
+                gdd->csel = f->n;
+        order_filter(gdd->order, keep_uncollapsed, &c);
+        free(c.t);
+}
+
+
+/* Each order is sorted the first time it's shown and kept until the list
+ * changes, so switching back to it is immediate. gdd->order is one of these,
+ * or a filtered copy of one while duplicates are hidden.
+ */
+void drop_orders(struct gd_data *gdd, int all)
+{
+        int i;
+
+        if (gdd->order && gdd->order != gdd->orders[gdd->order->mode])
+                free_commit_order(gdd->order);
+        gdd->order = NULL;
+        for (i = 0; all && i < ORDER_COUNT; i++) {
+                free_commit_order(gdd->orders[i]);
+                gdd->orders[i] = NULL;
+        }
+}
+
+
+/* The commit on show for n: n itself, or the one in its place if it's
+ * hidden as a duplicate. NULL if that can't be found.
+ */
+struct commit_node *shown_commit(struct gd_data *gdd, struct commit_node *n)
+{
+        struct commit_node *m;
+        uint64_t id, other;
+        int i, lo, hi;
+
+        if (!gdd->order || gdd->order->pos[n->ind] >= 0)
+                return n;
+        if (!gdd->pids || !commit_patchid(gdd->pids, n, &id))
+                return NULL;
+        selected_range(gdd, &lo, &hi);
+        for (i = 0; i < gdd->order->n; i++) {
+                m = gdd->order->v[i];
+                if (m->ind >= lo && m->ind < hi 
+                    && commit_patchid(gdd->pids, m, &other) && other == id)
+                        return m;
+        }
+
+        return NULL;
+}
+
+
+/* Sets up the order the list is shown in. git log order with nothing hidden
+ * doesn't need one.
+ */
+void rebuild_order(struct gd_data *gdd, int mode)
+{
+        drop_orders(gdd, 0);
+        if (mode == ORDER_LOG && !gdd->collapse)
+                return;
+        if (!gdd->orders[mode])
+                gdd->orders[mode] = new_commit_order(gdd->cl, mode);
+        gdd->order = gdd->orders[mode];
+        if (gdd->collapse && gdd->pids) {
+                gdd->order = copy_commit_order(gdd->order);
+                collapse_duplicates(gdd);
+                gdd->recollapse = 0;
+                gdd->collapsed_at = now_ms();
+        }
+}
+
+
+/* Starts the pool that computes patch-ids in the background, but only if
+ * the commits we were given are in the repository we're in. Each commit is
+ * a git diff-tree, so this waits until duplicates are first asked for.
+ */
+int start_patchids(struct gd_data *gdd)
+{
+        static char *gitdir[] = { "rev-parse", "--absolute-git-dir", NULL };
+        char cwd[PATH_MAX], buf[PATH_MAX], obj[COMMIT_HEX_MAX_SIZE + 16];
+        char *exists[] = { "cat-file", "-t", obj, NULL };
+
+        if (!gdd->cl || !getcwd(cwd, sizeof(cwd)) 
+            || !git_output_line(cwd, gitdir, buf, sizeof(buf) - 32))
+                return 0;
+        hash_to_hex(gdd->cl->hash, gdd->cl->hashlen, obj);
+        strcat(obj, "^{commit}");
+        if (!git_output_line(cwd, exists, obj, sizeof(obj)))
+                return 0;
+        strcat(buf, "/gitdiff-patchids");
+        if (!(gdd->pids = new_patchid_pool(cwd, buf, cpu_count())))
+                return 0;
+        if (!add_ev_source(gdd, gdd->pids->resfd[0], patchids_ready)) {
+                free_patchid_pool(gdd->pids);
+                gdd->pids = NULL;
+                return 0;
+        }
+
+        return 1;
+}
+
+
+/* Only the commits in FROM..TO are compared, so only those are diffed.
+ * Each is queued once, however often the range moves over it.
+ */
+void queue_patchids(struct gd_data *gdd)
+{
+        struct commit_node *n;
+        int lo, hi;
+
+        if (!gdd->pids)
+                return;
+        selected_range(gdd, &lo, &hi);
+        for (n = gdd->cl; n && n->ind < hi; n = n->next) {
+                if (n->ind < lo || (n->flags & CN_PIDQUEUED))
+                        continue;
+                n->flags |= CN_PIDQUEUED;
+                patchid_enqueue(gdd->pids, n);
+        }
+}
+
+
+void patchids_ready(struct gd_data *gdd, int fd)
+{
+        if (!patchid_collect(gdd->pids))
+                return;
+        if (gdd->collapse)
+                gdd->recollapse = 1;
+        draw_list(gdd);
+        draw_statbar(gdd);
+}
+
+
+/* Drops everything derived from the list after commits have been added */
+void data_changed(struct gd_data *gdd)
+{
+        int mode;
+
+        free_hash_index(gdd->hidx);
+        gdd->hidx = NULL;
+        invalidate_row_cache(gdd->rc);
+        free_commit_stats(gdd->stats);
+        gdd->stats = NULL;
+        draw_stats(gdd);
+        mode = order_mode(gdd);
+        drop_orders(gdd, 1);
+        rebuild_order(gdd, mode);
+}
+
+
+/* Follows the repository we were started in, if any, so that new commits
+ * show up without a restart. Only done when we were given HEAD's own log.
+ */
+void watch_refs(struct gd_data *gdd)
+{
+        char cwd[PATH_MAX];
+
+        if (!getcwd(cwd, sizeof(cwd)) 
+            || !(gdd->rw = new_ref_watch(cwd, gdd->cl)))
+                return;
+        if (!add_ev_source(gdd, gdd->rw->fd, refs_changed)) {
+                free_ref_watch(gdd->rw);
+                gdd->rw = NULL;
+        }
+}
+
+
+/* New commits go on top of the list. The nodes already there keep their
+ * place on screen, so the selection, FROM, TO and what's in view are left
+ * as they were; only the indexes move down.
+ */
+void refs_changed(struct gd_data *gdd, int fd)
+{
+        static char mbuf[64];
+        struct commit_node *head, *tail, *n;
+        int count;
+
+        if (!ref_watch_changed(gdd->rw))
+                return;
+        if (!(head = fetch_new_commits(gdd->rw, &tail, &count))) {
+                if (count < 0) {
+                        gdd->msg = "HEAD has left this history; restart "
+                                   "gitdiff to load the new one";
+                        draw_statbar(gdd);
+                }
+                return;
+        }
+        for (n = gdd->cl; n; n = n->next)
+                n->ind += count;
+        tail->next = gdd->cl;
+        gdd->cl->prev = tail;
+        gdd->cl = head;
+        gdd->ccount += count;
+        queue_patchids(gdd);
+        data_changed(gdd);
+
+        draw_list(gdd);
+        snprintf(mbuf, sizeof(mbuf), "%d new commit%s", count, 
+                 (count == 1) ? "" : "s");
+        gdd->msg = mbuf;
+        draw_statbar(gdd);
+}
+
+
 void draw_towin(struct gd_data *gdd)
 {
         char *txt;
@@ -302,15 +991,23 @@ void draw_fromwin(struct gd_data *gdd)
 void draw_statbar(struct gd_data *gdd)
 {
         char sbuf[256];
-        int perc;
+        int perc, pos;
 
         werase(gdd->statwin);
-        sprintf(sbuf, "%d commits", gdd->ccount);
+        if (gdd->msg)
+                snprintf(sbuf, sizeof(sbuf), "%s", gdd->msg);
+        else if (gdd->order)
+                sprintf(sbuf, "%d commits, by %s%s", view_count(gdd), 
+                        ORDER_NAMES[gdd->order->mode],
+                        gdd->collapse ? ", duplicates hidden" : "");
+        else
+                sprintf(sbuf, "%d commits", gdd->ccount);
         waddstr(gdd->statwin, sbuf);
-        perc = 100 * (gdd->csel->ind + 1) / gdd->ccount;
-        if (gdd->csel->ind == 0) 
+        pos = view_pos(gdd, gdd->csel);
+        perc = 100 * (pos + 1) / view_count(gdd);
+        if (pos == 0) 
                 strcpy(sbuf, " TOP");
-        else if (gdd->csel->ind == gdd->ccount - 1) 
+        else if (pos == view_count(gdd) - 1) 
                 strcpy(sbuf, " BOT");
         else
                 sprintf(sbuf, "%3d%%", perc);
@@ -333,7 +1030,7 @@ int change_selection(struct gd_data *gdd, int diff)
         prevsel = gdd->lsel;
         prevn = gdd->csel;
         if (diff > 0) {
-                d = traverse_forward(&(gdd->csel), diff);
+                d = view_forward(gdd, &(gdd->csel), diff);
                 gdd->lsel += d*2;
                 maxpos = max_list_ind(gdd);
                 if (gdd->lsel > maxpos) {
@@ -341,7 +1038,7 @@ int change_selection(struct gd_data *gdd, int diff)
                         draw_list(gdd);
                 } 
         } else if (diff < 0) {
-                d = traverse_back(&(gdd->csel), -diff);
+                d = view_back(gdd, &(gdd->csel), -diff);
                 gdd->lsel -= d*2;
                 if (gdd->lsel < 1) {
                         gdd->lsel = 1;
@@ -355,25 +1052,124 @@ int change_selection(struct gd_data *gdd, int diff)
 }
 
 
-void ev_loop(struct gd_data *gdd, struct keybindings *kb)
+static long now_ms()
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+}
+
+
+int add_ev_source(struct gd_data *gdd, int fd, 
+                  void (*f)(struct gd_data *gdd, int fd))
+{
+        if (gdd->nevs == MAX_EV_SOURCES)
+                return 0;
+        gdd->evs[gdd->nevs].fd = fd;
+        gdd->evs[gdd->nevs].f = f;
+        gdd->nevs++;
+
+        return 1;
+}
+
+
+void remove_ev_source(struct gd_data *gdd, int fd)
+{
+        int i;
+
+        for (i = 0; i < gdd->nevs; i++) {
+                if (gdd->evs[i].fd == fd) {
+                        gdd->evs[i] = gdd->evs[--gdd->nevs];
+                        return;
+                }
+        }
+}
+
+
+/* Returns 0 when it's time to quit */
+int handle_key(struct gd_data *gdd, struct keybindings *kb, int ch, 
+               long *resize_at)
 {
-        int ch;
         struct command *cmd;
 
+        switch (ch) {
+        case 'q':
+                return 0;
+        case '\n':
+        case KEY_ENTER:
+                start_diff_tool(gdd);
+                break;
+        case KEY_RESIZE:
+                *resize_at = now_ms() + RESIZE_DEBOUNCE_MS;
+                break;
+        default:
+                gdd->msg = NULL;
+                if (gdd->recollapse 
+                    && now_ms() - gdd->collapsed_at >= RECOLLAPSE_MS) {
+                        rebuild_order(gdd, order_mode(gdd));
+                        draw_list(gdd);
+                        draw_statbar(gdd);
+                }
+                run_command((cmd = get_command(kb, ch)), gdd);
+                if (cmd)
+                        draw_statbar(gdd);
+        }
+
+        return 1;
+}
+
+
+/* Waits on the terminal, the resize pipe and any registered event sources.
+ * Keys are read without blocking until curses runs dry, so a burst of
+ * keypresses is handled before the screen is refreshed once.
+ */
+void ev_loop(struct gd_data *gdd, struct keybindings *kb)
+{
+        struct pollfd pfd[MAX_EV_SOURCES + 2];
+        struct ev_source evs[MAX_EV_SOURCES];
+        int i, npfd, nevs, ch, running, timeout;
+        long resize_at;
+        char buf[64];
+
         refresh_windows(gdd);
 
-        while ((ch = getch()) != 'q') {
-                switch (ch) {
-                case '\n':
-                case KEY_ENTER:
-                        start_diff_tool(gdd);
+        running = 1;
+        resize_at = -1;
+        while (running) {
+                pfd[0].fd = STDIN_FILENO;
+                pfd[1].fd = WINCH_PIPE[0];
+                nevs = gdd->nevs;
+                memcpy(evs, gdd->evs, nevs * sizeof(*evs));
+                for (i = 0; i < nevs; i++)
+                        pfd[i + 2].fd = evs[i].fd;
+                npfd = nevs + 2;
+                for (i = 0; i < npfd; i++) {
+                        pfd[i].events = POLLIN;
+                        pfd[i].revents = 0;
+                }
+                timeout = -1;
+                if (resize_at >= 0) {
+                        timeout = resize_at - now_ms();
+                        if (timeout < 0)
+                                timeout = 0;
+                }
+
+                if (poll(pfd, npfd, timeout) < 0 && errno != EINTR)
                         break;
-                case KEY_RESIZE:
+
+                if (pfd[1].revents & POLLIN)
+                        while (read(WINCH_PIPE[0], buf, sizeof(buf)) > 0)
+                                ;
+                while (running && (ch = getch()) != ERR)
+                        running = handle_key(gdd, kb, ch, &resize_at);
+                for (i = 0; i < nevs; i++)
+                        if (pfd[i + 2].revents & (POLLIN | POLLHUP))
+                                evs[i].f(gdd, evs[i].fd);
+
+                if (resize_at >= 0 && now_ms() >= resize_at) {
                         resize_windows(gdd);
-                default:
-                        run_command((cmd = get_command(kb, ch)), gdd);
-                        if (cmd)
-                                draw_statbar(gdd);
+                        resize_at = -1;
                 }
                 refresh_windows(gdd);
         }
@@ -382,10 +1178,8 @@ void ev_loop(struct gd_data *gdd, struct keybindings *kb)
 
 void refresh_windows(struct gd_data *gdd)
 {
-        if (gdd->lref) {
+        if (gdd->lref)
                 wrefresh(gdd->lwin);
-                gdd->lref = 0;
-        }
         if (gdd->tref) {
                 wrefresh(gdd->towin);
                 gdd->tref = 0;
@@ -398,19 +1192,40 @@ void refresh_windows(struct gd_data *gdd)
                 wrefresh(gdd->statwin);
                 gdd->sref = 0;
         }
+        /* The stats pane sits on top of the list */
+        if (gdd->stwin && (gdd->stref || gdd->lref)) {
+                touchwin(gdd->stwin);
+                wrefresh(gdd->stwin);
+        }
+        gdd->lref = gdd->stref = 0;
 }
 
 
 
+/* Called once a burst of KEY_RESIZEs has settled. curses has already
+ * resized stdscr by then; we cut new subwindows out of it and redraw the list
+ * around the same selection.
+ */
 void resize_windows(struct gd_data *gdd)
 {
-        endwin();
+        int maxpos;
+
+        clear();
         init_windows(gdd);
-        init_list(gdd);
+        layout_list(gdd);
+        maxpos = max_list_ind(gdd);
+        if (gdd->lsel > maxpos)
+                gdd->lsel = (maxpos < 1) ? 1 : maxpos;
         draw_list(gdd);
         draw_statbar(gdd);
         draw_fromwin(gdd);
         draw_towin(gdd);
+        if (gdd->stwin) {
+                delwin(gdd->stwin);
+                gdd->stwin = newwin(gdd->lh + 2, gdd->lw + 2, 
+                                    getbegy(gdd->lwin), getbegx(gdd->lwin));
+                draw_stats(gdd);
+        }
         gdd->lref = gdd->tref = gdd->fref = gdd->sref = 1;
         refresh();
 }
@@ -419,6 +1234,7 @@ void resize_windows(struct gd_data *gdd)
 void end_curses()
 {
         if (CURSES_SCREEN) {
+                sigaction(SIGWINCH, &CURSES_WINCH, NULL);
                 endwin();
                 CURSES_SCREEN = 0;
         }
@@ -432,18 +1248,32 @@ void start_diff_tool(struct gd_data *gdd)
 
         memset(astr, '\0', sizeof(astr));
         if (gdd->cfrom)
-                strncpy(astr, gdd->cfrom->hash, COMMIT_HASH_SIZE);
+                hash_to_hex(gdd->cfrom->hash, gdd->cfrom->hashlen, astr);
         else
                 strcpy(astr, "HEAD");
         strcat(astr, "..");
         if (gdd->cto)
-                strncat(astr, gdd->cto->hash, COMMIT_HASH_SIZE);
+                hash_to_hex(gdd->cto->hash, gdd->cto->hashlen, 
+                            astr + strlen(astr));
         else
                 strcpy(astr, "HEAD");
         execlp("git", "git", "difftool", astr, NULL);
 }
 
 
+/* Reads a line of input on the status bar */
+void prompt(struct gd_data *gdd, char *lbl, char *buf, int size)
+{
+        werase(gdd->statwin);
+        mvwaddstr(gdd->statwin, 0, 0, lbl);
+        echo();
+        curs_set(1);
+        wgetnstr(gdd->statwin, buf, size - 1);
+        curs_set(0);
+        noecho();
+}
+
+
 void run_command(struct command *cmd, struct gd_data *gdd)
 {
         if (cmd && cmd->f)
@@ -467,7 +1297,7 @@ void scrolldown(struct gd_data *gdd, char *arg)
 
 void scrolltotop(struct gd_data *gdd, char *arg)
 {
-        gdd->csel = gdd->cl;
+        gdd->csel = view_first(gdd);
         gdd->lsel = 1;
         draw_list(gdd);
 }
@@ -475,7 +1305,7 @@ void scrolltotop(struct gd_data *gdd, char *arg)
         
 void scrolltobottom(struct gd_data *gdd, char *arg)
 {
-        traverse_forward(&(gdd->csel), -1);
+        view_forward(gdd, &(gdd->csel), -1);
         gdd->lsel = max_list_ind(gdd);
         draw_list(gdd);
         gdd->lref = 1;
@@ -503,7 +1333,7 @@ void perc(struct gd_data *gdd, char *arg)
                 p = 0;
         else if (p > 100)
                 p = 100;
-        diff = (gdd->csel->ind) - ((gdd->ccount - 1) * p) / 100;
+        diff = view_pos(gdd, gdd->csel) - ((view_count(gdd) - 1) * p) / 100;
         change_selection(gdd, -diff);
 }
 
@@ -512,7 +1342,11 @@ void selto(struct gd_data *gdd, char *arg)
 {
         gdd->cto = gdd->csel;
         draw_towin(gdd);
+        queue_patchids(gdd);
+        if (gdd->collapse)
+                rebuild_order(gdd, order_mode(gdd));
         draw_list(gdd);
+        draw_stats(gdd);
 }
 
 
@@ -520,10 +1354,102 @@ void selfrom(struct gd_data *gdd, char *arg)
 {
         gdd->cfrom = gdd->csel;
         draw_fromwin(gdd);
+        queue_patchids(gdd);
+        if (gdd->collapse)
+                rebuild_order(gdd, order_mode(gdd));
+        draw_list(gdd);
+        draw_stats(gdd);
+}
+
+
+/* Shows or hides the stats pane over the list. The counts follow FROM..TO
+ * while it's up.
+ */
+void togglestats(struct gd_data *gdd, char *arg)
+{
+        if (gdd->stwin) {
+                delwin(gdd->stwin);
+                gdd->stwin = NULL;
+                touchwin(gdd->lwin);
+                gdd->lref = 1;
+                return;
+        }
+        gdd->stwin = newwin(gdd->lh + 2, gdd->lw + 2, getbegy(gdd->lwin), 
+                            getbegx(gdd->lwin));
+        draw_stats(gdd);
+}
+
+
+void gotohash(struct gd_data *gdd, char *arg)
+{
+        char pbuf[COMMIT_HEX_MAX_SIZE + 1];
+        struct commit_node *n;
+        char *p, *e;
+
+        memset(pbuf, '\0', sizeof(pbuf));
+        prompt(gdd, "commit: ", pbuf, sizeof(pbuf));
+        for (p = pbuf; isspace((unsigned char)*p); p++)
+                ;
+        for (e = p + strlen(p); e > p && isspace((unsigned char)e[-1]); )
+                *--e = '\0';
+        if (!*p)
+                return;
+        if (!gdd->hidx)
+                gdd->hidx = new_hash_index(gdd->cl);
+        switch (hash_index_lookup(gdd->hidx, p, &n)) {
+        case HI_FOUND:
+                if (!(n = shown_commit(gdd, n))) {
+                        gdd->msg = "That commit is hidden as a duplicate";
+                        break;
+                }
+                gdd->csel = n;
+                draw_list(gdd);
+                break;
+        case HI_AMBIGUOUS:
+                gdd->msg = "Ambiguous commit prefix";
+                break;
+        default:
+                gdd->msg = "No such commit";
+        }
+}
+
+
+/* Cycles through the orders in ORDER_NAMES, keeping the same commit
+ * selected
+ */
+void nextorder(struct gd_data *gdd, char *arg)
+{
+        rebuild_order(gdd, (order_mode(gdd) + 1) % ORDER_COUNT);
         draw_list(gdd);
 }
 
 
+/* Hides all but the newest of the commits in FROM..TO that make the same
+ * change. Only works as well as the patch-ids computed so far; the first
+ * time, that's only what's cached, and the rest follow in the background.
+ */
+void togglecollapse(struct gd_data *gdd, char *arg)
+{
+        static char mbuf[64];
+        int before;
+
+        if (!gdd->pids && !start_patchids(gdd)) {
+                gdd->msg = "No patch-ids outside a git repository";
+                return;
+        }
+        queue_patchids(gdd);
+        gdd->collapse = !gdd->collapse;
+        before = view_count(gdd);
+        rebuild_order(gdd, order_mode(gdd));
+        draw_list(gdd);
+        if (gdd->collapse) {
+                snprintf(mbuf, sizeof(mbuf), "Collapsed %d duplicates", 
+                         before - view_count(gdd));
+                gdd->msg = mbuf;
+        }
+}
+
+
 void find(struct gd_data *gdd, char *arg)
 {
 }
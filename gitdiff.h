@@ -6,10 +6,18 @@
 #define GITDIFF_H
 
 #include "commitlist.h"
+#include "hashindex.h"
+#include "rowcache.h"
+#include "stats.h"
+#include "indexd.h"
+#include "refwatch.h"
+#include "order.h"
+#include "patchid.h"
 #include <curses.h>
 
 #define ARRYSIZE(x)     (sizeof(x)/sizeof(x[0]))
 #define NUMKEYS         (1<<8)
+#define MAX_EV_SOURCES  8
 
 
 enum {
@@ -20,14 +28,41 @@ enum {
 };
 
 
+struct gd_data;
+
+
+/* Something besides the keyboard that ev_loop() waits on, e.g. the read end
+ * of a pipe that a worker thread writes to when it has results. f is called
+ * on the main thread whenever fd is readable.
+ */
+struct ev_source {
+        int fd;
+        void (*f)(struct gd_data *gdd, int fd);
+};
+
+
 struct  gd_data {
-        WINDOW *lwin, *fromwin, *towin, *statwin;
-        int lref, fref, tref, sref;
+        WINDOW *lwin, *fromwin, *towin, *statwin, *stwin;
+        int lref, fref, tref, sref, stref;
         commit_list cl;
         int lsel, lw, lh;
         struct commit_node *csel;
         struct commit_node *cfrom, *cto;
         int ccount;
+        struct hash_index *hidx;
+        struct row_cache *rc;
+        struct commit_stats *stats;
+        struct index_image img;
+        struct ref_watch *rw;
+        struct commit_order *order;     /* NULL for git log order */
+        struct commit_order *orders[ORDER_COUNT];       /* Sorted so far */
+        struct patchid_pool *pids;
+        int collapse;
+        int recollapse;                 /* New patch-ids since collapsing */
+        long collapsed_at;
+        char *msg;
+        struct ev_source evs[MAX_EV_SOURCES];
+        int nevs;
 };
 
 
@@ -38,6 +73,11 @@ struct command {
 
 
 
+int add_ev_source(struct gd_data *gdd, int fd, 
+                  void (*f)(struct gd_data *gdd, int fd));
+void remove_ev_source(struct gd_data *gdd, int fd);
+
+
 /* Commands */
 
 void scrollup(struct gd_data *gdd, char *arg);
@@ -49,6 +89,10 @@ void pageup(struct gd_data *gdd, char *arg);
 void perc(struct gd_data *gdd, char *arg);
 void selto(struct gd_data *gdd, char *arg);
 void selfrom(struct gd_data *gdd, char *arg);
+void gotohash(struct gd_data *gdd, char *arg);
+void togglestats(struct gd_data *gdd, char *arg);
+void nextorder(struct gd_data *gdd, char *arg);
+void togglecollapse(struct gd_data *gdd, char *arg);
 void find(struct gd_data *gdd, char *arg);
 void selnext(struct gd_data *gdd, char *arg);
 void selnext(struct gd_data *gdd, char *arg);
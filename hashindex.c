@@ -0,0 +1,93 @@
+/* hashindex.c - Looking up commits by (abbreviated) hash
+ * gitdiff contributors, 2026
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "hashindex.h"
+
+
+/* Compares the first nibbles hex digits of n's hash against prefix p. A hash
+ * shorter than the prefix sorts before it, same as in node_hash_cmp().
+ */
+static int prefix_cmp(const struct commit_node *n, const unsigned char *p, 
+                      int nibbles)
+{
+        int c, len;
+
+        len = (nibbles < n->hashlen * 2) ? nibbles : n->hashlen * 2;
+        if ((c = memcmp(n->hash, p, len / 2)))
+                return c;
+        if (len % 2 && (c = (n->hash[len / 2] >> 4) - (p[len / 2] >> 4)))
+                return c;
+        return (len < nibbles) ? -1 : 0;
+}
+
+
+static int node_hash_cmp(const void *a, const void *b)
+{
+        const struct commit_node *x = *(struct commit_node* const*)a;
+        const struct commit_node *y = *(struct commit_node* const*)b;
+        int c;
+
+        c = memcmp(x->hash, y->hash, 
+                   (x->hashlen < y->hashlen) ? x->hashlen : y->hashlen);
+        return c ? c : x->hashlen - y->hashlen;
+}
+
+
+struct hash_index *new_hash_index(commit_list cl)
+{
+        struct hash_index *hi;
+        struct commit_node *n;
+        int i;
+
+        hi = (struct hash_index*)malloc(sizeof(struct hash_index));
+        hi->n = commit_list_count(cl);
+        hi->v = (struct commit_node**)malloc((hi->n + 1) * sizeof(*hi->v));
+        for (n = cl, i = 0; n; n = n->next)
+                hi->v[i++] = n;
+        qsort(hi->v, hi->n, sizeof(*hi->v), node_hash_cmp);
+
+        return hi;
+}
+
+
+void free_hash_index(struct hash_index *hi)
+{
+        if (!hi)
+                return;
+        free(hi->v);
+        free(hi);
+}
+
+
+int hash_index_lookup(struct hash_index *hi, const char *prefix, 
+                      struct commit_node **found)
+{
+        unsigned char p[COMMIT_HASH_MAX_SIZE];
+        int nibbles, lo, hi_, mid;
+
+        *found = NULL;
+        memset(p, '\0', sizeof(p));
+        nibbles = hex_to_hash(prefix, p, COMMIT_HASH_MAX_SIZE);
+        if (!nibbles || prefix[nibbles] != '\0')
+                return HI_NOTFOUND;
+
+        lo = 0;
+        hi_ = hi->n;
+        while (lo < hi_) {
+                mid = lo + (hi_ - lo) / 2;
+                if (prefix_cmp(hi->v[mid], p, nibbles) < 0)
+                        lo = mid + 1;
+                else
+                        hi_ = mid;
+        }
+        if (lo == hi->n || prefix_cmp(hi->v[lo], p, nibbles))
+                return HI_NOTFOUND;
+        *found = hi->v[lo];
+        if (lo + 1 < hi->n && !prefix_cmp(hi->v[lo + 1], p, nibbles))
+                return HI_AMBIGUOUS;
+
+        return HI_FOUND;
+}
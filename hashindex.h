@@ -0,0 +1,35 @@
+/* hashindex.h - Looking up commits by (abbreviated) hash
+ * gitdiff contributors, 2026
+ *
+ * The index is just the commit nodes sorted by their binary hash, so a
+ * prefix lookup is a binary search for the first hash not below the prefix
+ * followed by a peek at its neighbour to tell whether the prefix is unique.
+ */
+
+#ifndef HASHINDEX_H
+#define HASHINDEX_H
+
+#include "commitlist.h"
+
+
+enum {
+        HI_NOTFOUND = 0,
+        HI_FOUND,
+        HI_AMBIGUOUS
+};
+
+
+struct hash_index {
+        struct commit_node **v;
+        int n;
+};
+
+
+struct hash_index *new_hash_index(commit_list cl);
+void free_hash_index(struct hash_index *hi);
+int hash_index_lookup(struct hash_index *hi, const char *prefix, 
+                      struct commit_node **found);
+
+
+
+#endif
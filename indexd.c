@@ -0,0 +1,549 @@
+/* indexd.c - Sharing parsed histories between gitdiff sessions
+ * gitdiff contributors, 2026
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <signal.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include "indexd.h"
+#include "gitcmd.h"
+
+#define INDEX_MAGIC     "GDIDX01"
+
+#define REPLY_OK        'O'
+#define REPLY_ERR       'E'
+
+/* Images are dropped, least recently used first, once there are more than
+ * this many repositories or they add up to more than this many bytes
+ */
+#define INDEX_MAX_REPOS         16
+#define INDEX_MAX_BYTES         ((size_t)1 << 30)
+
+
+struct index_header {
+        char magic[8];
+        uint32_t count;
+        uint32_t reserved;
+        uint64_t size;
+};
+
+
+/* String offsets are from the start of the image; 0 means NULL */
+struct index_rec {
+        uint64_t date, author, comment;
+        uint8_t hashlen;
+        uint8_t hash[COMMIT_HASH_MAX_SIZE];
+};
+
+
+struct index_entry {
+        char top[PATH_MAX];
+        char head[COMMIT_HEX_MAX_SIZE + 1];
+        int fd;
+        size_t size;
+        int building;                   /* A thread is parsing its history */
+        unsigned long used;
+        struct index_entry *next;
+};
+
+
+/* Shared by the threads serving clients. Histories are parsed with the lock
+ * released, so only clients of the same repository wait on each other.
+ */
+struct index_cache {
+        struct index_entry *entries;
+        pthread_mutex_t lock;
+        pthread_cond_t built;
+        unsigned long clock;
+};
+
+
+struct index_client {
+        struct index_cache *cache;
+        int sock;
+};
+
+
+static size_t str_size(const char *s)
+{
+        return s ? strlen(s) + 1 : 0;
+}
+
+
+static uint64_t put_str(char *img, size_t *off, const char *s)
+{
+        uint64_t at;
+
+        if (!s)
+                return 0;
+        at = *off;
+        memcpy(img + at, s, strlen(s) + 1);
+        *off += strlen(s) + 1;
+
+        return at;
+}
+
+
+/* Lays cl out as an image in a new memfd and seals it against changes.
+ * Returns the fd or -1, and the image's size through psize.
+ */
+static int build_image(commit_list cl, size_t *psize)
+{
+        struct index_header *hdr;
+        struct index_rec *rec;
+        struct commit_node *n;
+        size_t size, off;
+        char *img;
+        int fd, count;
+
+        count = commit_list_count(cl);
+        size = sizeof(*hdr) + count * sizeof(*rec);
+        for (n = cl; n; n = n->next)
+                size += str_size(n->date) + str_size(n->author) 
+                        + str_size(commit_comment(n));
+
+        fd = memfd_create("gitdiff-index", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+        if (fd < 0)
+                return -1;
+        if (ftruncate(fd, size) < 0 
+            || (img = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, 
+                           fd, 0)) == MAP_FAILED) {
+                close(fd);
+                return -1;
+        }
+
+        hdr = (struct index_header*)img;
+        memcpy(hdr->magic, INDEX_MAGIC, sizeof(hdr->magic));
+        hdr->count = count;
+        hdr->reserved = 0;
+        hdr->size = size;
+        rec = (struct index_rec*)(hdr + 1);
+        off = sizeof(*hdr) + count * sizeof(*rec);
+        for (n = cl; n; n = n->next, rec++) {
+                rec->date = put_str(img, &off, n->date);
+                rec->author = put_str(img, &off, n->author);
+                rec->comment = put_str(img, &off, commit_comment(n));
+                rec->hashlen = n->hashlen;
+                memcpy(rec->hash, n->hash, n->hashlen);
+        }
+        munmap(img, size);
+        if (fcntl(fd, F_ADD_SEALS, 
+                  F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) < 0) {
+                close(fd);
+                return -1;
+        }
+        *psize = size;
+
+        return fd;
+}
+
+
+/* Parses the history of the repository at top into a new image. Returns
+ * the fd or -1.
+ */
+static int parse_image(const char *top, size_t *psize)
+{
+        static char *log[] = { "log", "--pretty=medium", "--no-color", 
+                               "--decorate=no", NULL };
+        commit_list cl;
+        FILE *f;
+        pid_t pid;
+        int fd;
+
+        if (!(f = git_popen(top, log, &pid)))
+                return -1;
+        cl = parse_commit_list(f);
+        git_pclose(f, pid);
+        if (!cl)
+                return -1;
+        fd = build_image(cl, psize);
+        free_commit_list(&cl);
+
+        return fd;
+}
+
+
+/* Drops the least recently used images, other than keep and any being
+ * built, until the cache is back within its limits. Sessions using a
+ * dropped image keep their own mapping of it. Called with the lock held.
+ */
+static void evict_images(struct index_cache *cache, struct index_entry *keep)
+{
+        struct index_entry **pe, **lru, *e;
+        size_t bytes;
+        int count;
+
+        for (;;) {
+                count = 0;
+                bytes = 0;
+                lru = NULL;
+                for (pe = &cache->entries; (e = *pe); pe = &e->next) {
+                        count++;
+                        bytes += e->size;
+                        if (e != keep && !e->building
+                            && (!lru || e->used < (*lru)->used))
+                                lru = pe;
+                }
+                if (!lru || (count <= INDEX_MAX_REPOS 
+                             && bytes <= INDEX_MAX_BYTES))
+                        return;
+                e = *lru;
+                *lru = e->next;
+                if (e->fd >= 0)
+                        close(e->fd);
+                free(e);
+        }
+}
+
+
+/* Returns a new fd for the image of the repository containing dir, parsing
+ * its history again if HEAD has moved since last time, or -1. If that fails
+ * the old image is kept, but isn't handed out, and the next request tries
+ * again.
+ */
+static int get_image(struct index_cache *cache, const char *dir)
+{
+        static char *toplevel[] = { "rev-parse", "--show-toplevel", NULL };
+        static char *head[] = { "rev-parse", "HEAD", NULL };
+        char top[PATH_MAX], hbuf[COMMIT_HEX_MAX_SIZE + 2];
+        struct index_entry *e;
+        size_t size;
+        int fd;
+
+        if (!git_output_line(dir, toplevel, top, sizeof(top))
+            || !git_output_line(top, head, hbuf, sizeof(hbuf)))
+                return -1;
+
+        pthread_mutex_lock(&cache->lock);
+        for (;;) {
+                for (e = cache->entries; e && strcmp(e->top, top); e = e->next)
+                        ;
+                if (!e || !e->building)
+                        break;
+                pthread_cond_wait(&cache->built, &cache->lock);
+        }
+        if (e && e->fd >= 0 && !strcmp(e->head, hbuf)) {
+                e->used = ++cache->clock;
+                fd = fcntl(e->fd, F_DUPFD_CLOEXEC, 0);
+                pthread_mutex_unlock(&cache->lock);
+                return fd;
+        }
+        if (!e) {
+                e = (struct index_entry*)malloc(sizeof(struct index_entry));
+                strcpy(e->top, top);
+                e->head[0] = '\0';
+                e->fd = -1;
+                e->size = 0;
+                e->next = cache->entries;
+                cache->entries = e;
+        }
+        e->building = 1;
+        e->used = ++cache->clock;
+        pthread_mutex_unlock(&cache->lock);
+
+        fd = parse_image(top, &size);
+
+        pthread_mutex_lock(&cache->lock);
+        e->building = 0;
+        if (fd >= 0) {
+                if (e->fd >= 0)
+                        close(e->fd);
+                e->fd = fd;
+                e->size = size;
+                strcpy(e->head, hbuf);
+                fd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+        }
+        evict_images(cache, e);
+        pthread_cond_broadcast(&cache->built);
+        pthread_mutex_unlock(&cache->lock);
+
+        return fd;
+}
+
+
+static int send_reply(int sock, char status, int fd)
+{
+        char cbuf[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr *cm;
+        struct msghdr msg;
+        struct iovec iov;
+
+        memset(&msg, 0, sizeof(msg));
+        iov.iov_base = &status;
+        iov.iov_len = 1;
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        if (fd >= 0) {
+                memset(cbuf, 0, sizeof(cbuf));
+                msg.msg_control = cbuf;
+                msg.msg_controllen = sizeof(cbuf);
+                cm = CMSG_FIRSTHDR(&msg);
+                cm->cmsg_level = SOL_SOCKET;
+                cm->cmsg_type = SCM_RIGHTS;
+                cm->cmsg_len = CMSG_LEN(sizeof(int));
+                memcpy(CMSG_DATA(cm), &fd, sizeof(int));
+        }
+
+        return sendmsg(sock, &msg, MSG_NOSIGNAL) == 1;
+}
+
+
+/* A request is the path of a directory in the repository, ending in '\n' */
+static void serve_client(struct index_cache *cache, int sock)
+{
+        char dir[PATH_MAX];
+        size_t len;
+        ssize_t r;
+        int fd;
+
+        len = 0;
+        while (len < sizeof(dir) - 1) {
+                if ((r = read(sock, dir + len, sizeof(dir) - 1 - len)) <= 0)
+                        break;
+                len += r;
+                if (memchr(dir + len - r, '\n', r))
+                        break;
+        }
+        dir[len] = '\0';
+        if (!strchr(dir, '\n')) {
+                send_reply(sock, REPLY_ERR, -1);
+                return;
+        }
+        *strchr(dir, '\n') = '\0';
+        fd = get_image(cache, dir);
+        send_reply(sock, (fd >= 0) ? REPLY_OK : REPLY_ERR, fd);
+        if (fd >= 0)
+                close(fd);
+}
+
+
+static void *client_thread(void *arg)
+{
+        struct index_client *c = (struct index_client*)arg;
+
+        serve_client(c->cache, c->sock);
+        close(c->sock);
+        free(c);
+
+        return NULL;
+}
+
+
+static int unix_socket(const char *sockpath, struct sockaddr_un *addr)
+{
+        if (strlen(sockpath) >= sizeof(addr->sun_path))
+                return -1;
+        memset(addr, 0, sizeof(*addr));
+        addr->sun_family = AF_UNIX;
+        strcpy(addr->sun_path, sockpath);
+
+        return socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+}
+
+
+/* Serves requests on sockpath until killed. Only returns on error. */
+int run_index_daemon(const char *sockpath)
+{
+        struct index_cache cache;
+        struct index_client *c;
+        struct sockaddr_un addr;
+        pthread_attr_t attr;
+        pthread_t th;
+        struct timeval tv;
+        int lsock, sock;
+
+        if ((lsock = unix_socket(sockpath, &addr)) < 0) {
+                perror(sockpath);
+                return 1;
+        }
+        unlink(sockpath);
+        if (bind(lsock, (struct sockaddr*)&addr, sizeof(addr)) < 0 
+            || listen(lsock, 16) < 0) {
+                perror(sockpath);
+                close(lsock);
+                return 1;
+        }
+        signal(SIGPIPE, SIG_IGN);
+
+        /* Each client gets a thread, so one whose repository is still being
+         * parsed doesn't hold up the others. One that never finishes its
+         * request would still tie up a thread, so it's timed out. */
+        tv.tv_sec = 5;
+        tv.tv_usec = 0;
+        cache.entries = NULL;
+        cache.clock = 0;
+        pthread_mutex_init(&cache.lock, NULL);
+        pthread_cond_init(&cache.built, NULL);
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        for (;;) {
+                if ((sock = accept4(lsock, NULL, NULL, SOCK_CLOEXEC)) < 0)
+                        continue;
+                setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+                c = (struct index_client*)malloc(sizeof(struct index_client));
+                c->cache = &cache;
+                c->sock = sock;
+                if (pthread_create(&th, &attr, client_thread, c))
+                        client_thread(c);
+        }
+
+        return 0;
+}
+
+
+static int recv_reply(int sock, int *fd)
+{
+        char cbuf[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr *cm;
+        struct msghdr msg;
+        struct iovec iov;
+        char status;
+
+        memset(&msg, 0, sizeof(msg));
+        iov.iov_base = &status;
+        iov.iov_len = 1;
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = cbuf;
+        msg.msg_controllen = sizeof(cbuf);
+        *fd = -1;
+        if (recvmsg(sock, &msg, MSG_CMSG_CLOEXEC) != 1)
+                return 0;
+        for (cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm))
+                if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_RIGHTS)
+                        memcpy(fd, CMSG_DATA(cm), sizeof(int));
+
+        return status == REPLY_OK && *fd >= 0;
+}
+
+
+/* Checks that off is 0 or a NUL-terminated string in the string area,
+ * which runs from start to the end of the image
+ */
+static int image_str(struct index_image *img, uint64_t start, uint64_t off,
+                     char **s)
+{
+        char *base;
+
+        base = (char*)img->map;
+        *s = NULL;
+        if (!off)
+                return 1;
+        if (off < start || off >= img->len 
+            || !memchr(base + off, '\0', img->len - off))
+                return 0;
+        *s = base + off;
+
+        return 1;
+}
+
+
+/* The image comes from another process, so nothing in it is trusted */
+static commit_list image_to_list(struct index_image *img)
+{
+        struct index_header *hdr;
+        struct index_rec *rec;
+        struct commit_node *root, *last, *n;
+        char *base, *date, *author, *comment;
+        uint64_t start;
+        uint32_t i;
+
+        base = (char*)img->map;
+        hdr = (struct index_header*)base;
+        if (img->len < sizeof(*hdr) || memcmp(hdr->magic, INDEX_MAGIC, 8)
+            || hdr->size != img->len
+            || sizeof(*hdr) + (uint64_t)hdr->count * sizeof(*rec) > img->len)
+                return NULL;
+
+        root = last = NULL;
+        start = sizeof(*hdr) + (uint64_t)hdr->count * sizeof(*rec);
+        rec = (struct index_rec*)(hdr + 1);
+        for (i = 0; i < hdr->count; i++, rec++) {
+                if (rec->hashlen > COMMIT_HASH_MAX_SIZE
+                    || !image_str(img, start, rec->date, &date)
+                    || !image_str(img, start, rec->author, &author)
+                    || !image_str(img, start, rec->comment, &comment)) {
+                        free_commit_list(&root);
+                        return NULL;
+                }
+                n = new_commit_node(i, last, NULL, rec->hashlen);
+                memcpy(n->hash, rec->hash, rec->hashlen);
+                n->flags |= CN_SHARED;
+                n->date = date;
+                n->author = author;
+                n->comment = comment;
+                if (last)
+                        last->next = n;
+                else
+                        root = n;
+                last = n;
+        }
+
+        return root;
+}
+
+
+/* Asks the daemon at sockpath for the history of the repository containing
+ * repo. Returns NULL if there's no daemon or it couldn't help; otherwise img
+ * keeps the mapping alive until detach_commit_index().
+ */
+commit_list attach_commit_index(const char *sockpath, const char *repo,
+                                struct index_image *img)
+{
+        struct sockaddr_un addr;
+        struct stat st;
+        commit_list cl;
+        int sock, fd, seals;
+
+        img->map = NULL;
+        img->len = 0;
+        if ((sock = unix_socket(sockpath, &addr)) < 0)
+                return NULL;
+        if (connect(sock, (struct sockaddr*)&addr, sizeof(addr)) < 0
+            || write(sock, repo, strlen(repo)) != (ssize_t)strlen(repo)
+            || write(sock, "\n", 1) != 1
+            || !recv_reply(sock, &fd)) {
+                close(sock);
+                return NULL;
+        }
+        close(sock);
+
+        /* Unless it's sealed, it could change after it's been checked */
+        seals = fcntl(fd, F_GET_SEALS);
+        if (seals < 0 || (seals & (F_SEAL_WRITE | F_SEAL_SHRINK)) 
+                         != (F_SEAL_WRITE | F_SEAL_SHRINK)
+            || fstat(fd, &st) < 0 || st.st_size == 0
+            || (img->map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, 
+                                fd, 0)) == MAP_FAILED) {
+                img->map = NULL;
+                close(fd);
+                return NULL;
+        }
+        close(fd);
+        img->len = st.st_size;
+        if (!(cl = image_to_list(img)))
+                detach_commit_index(img);
+
+        return cl;
+}
+
+
+void detach_commit_index(struct index_image *img)
+{
+        if (img->map)
+                munmap(img->map, img->len);
+        img->map = NULL;
+        img->len = 0;
+}
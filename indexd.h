@@ -0,0 +1,44 @@
+/* indexd.h - Sharing parsed histories between gitdiff sessions
+ * gitdiff contributors, 2026
+ *
+ * The index daemon parses "git log" once per repository and keeps the
+ * result as a flat image in a sealed memfd: a header, a fixed size record
+ * per commit, and the strings the records point to by offset. Clients ask
+ * for a repository over a Unix socket, get the memfd back, and map it read
+ * only. Each client builds its own list nodes, but the strings are used in
+ * place, so every session on the host shares one copy of them.
+ *
+ * Attaching is not instant: it skips running git log and parsing, but still
+ * allocates and links a node per commit, so it takes time and memory in
+ * proportion to the length of the history.
+ *
+ * Each client is served on its own thread, so a repository being parsed for
+ * the first time only holds up other clients of that repository. The most
+ * recently used images are kept, up to a limit on their number and total
+ * size.
+ *
+ * The daemon runs git as whoever started it, so the socket should only be
+ * reachable by users who may read the repositories it serves.
+ */
+
+#ifndef INDEXD_H
+#define INDEXD_H
+
+#include <stddef.h>
+#include "commitlist.h"
+
+
+struct index_image {
+        void *map;
+        size_t len;
+};
+
+
+int run_index_daemon(const char *sockpath);
+commit_list attach_commit_index(const char *sockpath, const char *repo,
+                                struct index_image *img);
+void detach_commit_index(struct index_image *img);
+
+
+
+#endif
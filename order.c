@@ -0,0 +1,277 @@
+/* order.c - Browsing the commits in an order other than git log's
+ * gitdiff contributors, 2026
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "order.h"
+#include "authors.h"
+#include "parallel.h"
+
+/* Below this many commits a part isn't worth a thread */
+#define MIN_PART_SIZE   (32 * 1024)
+
+
+char *ORDER_NAMES[ORDER_COUNT] = { "log", "author", "date", "message" };
+
+
+/* Sort keys are worked out once up front. Ties go to git log order.
+ * Comments may be packed, and only a few can be unpacked at once, so for
+ * ORDER_MESSAGE each record gets a copy to compare instead.
+ */
+struct sort_rec {
+        union {
+                long long key;
+                char *msg;
+        };
+        int ind;
+        struct commit_node *n;
+};
+
+
+struct sort_part {
+        int mode;
+        struct sort_rec *src, *dst;
+        struct author_tab *at;
+        int lo, mid, hi;
+};
+
+
+static int rec_cmp_key(const struct sort_rec *a, const struct sort_rec *b)
+{
+        if (a->key != b->key)
+                return (a->key < b->key) ? -1 : 1;
+        return a->ind - b->ind;
+}
+
+
+static int rec_cmp_message(const struct sort_rec *a, const struct sort_rec *b)
+{
+        int c;
+
+        c = strcmp(a->msg, b->msg);
+        return c ? c : a->ind - b->ind;
+}
+
+
+static int qsort_key(const void *a, const void *b)
+{
+        return rec_cmp_key((const struct sort_rec*)a, 
+                           (const struct sort_rec*)b);
+}
+
+
+static int qsort_message(const void *a, const void *b)
+{
+        return rec_cmp_message((const struct sort_rec*)a, 
+                               (const struct sort_rec*)b);
+}
+
+
+/* Fills in and sorts src[lo, hi) */
+static void *sort_part(void *arg)
+{
+        struct sort_part *p = (struct sort_part*)arg;
+        struct sort_rec *r;
+        int i;
+
+        for (i = p->lo; i < p->hi; i++) {
+                r = &p->src[i];
+                if (p->mode == ORDER_AUTHOR)
+                        r->key = p->at->ids[r->ind];
+                else if (p->mode == ORDER_DATE)
+                        /* Newest first, like git log */
+                        r->key = -(long long)commit_time(r->n->date);
+        }
+        qsort(p->src + p->lo, p->hi - p->lo, sizeof(*p->src), 
+              (p->mode == ORDER_MESSAGE) ? qsort_message : qsort_key);
+
+        return NULL;
+}
+
+
+/* Merges the sorted runs src[lo, mid) and src[mid, hi) into dst */
+static void *merge_part(void *arg)
+{
+        struct sort_part *p = (struct sort_part*)arg;
+        int i, j, k, c;
+
+        i = p->lo;
+        j = p->mid;
+        for (k = p->lo; k < p->hi; k++) {
+                if (i == p->mid) {
+                        c = 1;
+                } else if (j == p->hi) {
+                        c = -1;
+                } else {
+                        c = (p->mode == ORDER_MESSAGE) 
+                                ? rec_cmp_message(&p->src[i], &p->src[j])
+                                : rec_cmp_key(&p->src[i], &p->src[j]);
+                }
+                p->dst[k] = (c <= 0) ? p->src[i++] : p->src[j++];
+        }
+
+        return NULL;
+}
+
+
+/* Sorts n records: each thread sorts a slice, then the slices are merged in
+ * pairs, a thread per pair, until there's one left
+ */
+static struct sort_rec *parallel_sort(struct sort_rec *recs, int n, int mode,
+                                      struct author_tab *at)
+{
+        struct sort_part *p;
+        struct sort_rec *tmp, *t;
+        int nparts, i, m;
+
+        for (nparts = 1; nparts * 2 <= cpu_count() 
+                         && n / (nparts * 2) >= MIN_PART_SIZE; nparts *= 2)
+                ;
+        p = (struct sort_part*)malloc(nparts * sizeof(*p));
+        for (i = 0; i < nparts; i++) {
+                p[i].mode = mode;
+                p[i].src = recs;
+                p[i].at = at;
+                p[i].lo = (long)n * i / nparts;
+                p[i].hi = (long)n * (i + 1) / nparts;
+        }
+        run_parallel(sort_part, p, sizeof(*p), nparts);
+
+        tmp = (struct sort_rec*)malloc((n + 1) * sizeof(*tmp));
+        for (; nparts > 1; nparts = m) {
+                m = nparts / 2;
+                for (i = 0; i < m; i++) {
+                        p[i].src = recs;
+                        p[i].dst = tmp;
+                        p[i].lo = p[2 * i].lo;
+                        p[i].mid = p[2 * i].hi;
+                        p[i].hi = p[2 * i + 1].hi;
+                }
+                run_parallel(merge_part, p, sizeof(*p), m);
+                t = recs;
+                recs = tmp;
+                tmp = t;
+        }
+        free(tmp);
+        free(p);
+
+        return recs;
+}
+
+
+struct commit_order *new_commit_order(commit_list cl, int mode)
+{
+        struct commit_order *o;
+        struct author_tab *at;
+        struct sort_rec *recs;
+        struct commit_node *n;
+        const char *msg;
+        int i;
+
+        o = (struct commit_order*)malloc(sizeof(struct commit_order));
+        o->mode = mode;
+        o->v = commit_list_array(cl, &o->n);
+        o->count = o->n;
+        o->pos = (int*)malloc((o->n + 1) * sizeof(int));
+
+        if (mode != ORDER_LOG) {
+                recs = (struct sort_rec*)malloc((o->n + 1) * sizeof(*recs));
+                for (i = 0; i < o->n; i++) {
+                        recs[i].ind = o->v[i]->ind;
+                        recs[i].n = o->v[i];
+                        if (mode == ORDER_MESSAGE) {
+                                msg = commit_comment(o->v[i]);
+                                recs[i].msg = strdup(msg ? msg : "");
+                        }
+                }
+                at = (mode == ORDER_AUTHOR) ? new_author_tab(o->v, o->n) 
+                                            : NULL;
+                recs = parallel_sort(recs, o->n, mode, at);
+                for (i = 0; i < o->n; i++) {
+                        o->v[i] = recs[i].n;
+                        if (mode == ORDER_MESSAGE)
+                                free(recs[i].msg);
+                }
+                free_author_tab(at);
+                free(recs);
+        }
+        for (i = 0; i < o->n; i++) {
+                n = o->v[i];
+                o->pos[n->ind] = i;
+        }
+
+        return o;
+}
+
+
+/* For filtering without sorting all over again */
+struct commit_order *copy_commit_order(struct commit_order *o)
+{
+        struct commit_order *c;
+
+        c = (struct commit_order*)malloc(sizeof(struct commit_order));
+        *c = *o;
+        c->v = (struct commit_node**)malloc((o->n + 1) * sizeof(*c->v));
+        memcpy(c->v, o->v, o->n * sizeof(*c->v));
+        c->pos = (int*)malloc((o->count + 1) * sizeof(int));
+        memcpy(c->pos, o->pos, o->count * sizeof(int));
+
+        return c;
+}
+
+
+void free_commit_order(struct commit_order *o)
+{
+        if (!o)
+                return;
+        free(o->v);
+        free(o->pos);
+        free(o);
+}
+
+
+/* Drops the commits keep() says no to */
+void order_filter(struct commit_order *o, 
+                  int (*keep)(struct commit_node *n, void *arg), void *arg)
+{
+        int i, j;
+
+        for (i = 0, j = 0; i < o->n; i++) {
+                if (keep(o->v[i], arg)) {
+                        o->pos[o->v[i]->ind] = j;
+                        o->v[j++] = o->v[i];
+                } else {
+                        o->pos[o->v[i]->ind] = -1;
+                }
+        }
+        o->n = j;
+}
+
+
+/* Same as traverse_forward(), but in this order */
+int order_traverse_forward(struct commit_order *o, struct commit_node **n,
+                           int max)
+{
+        int p, t;
+
+        p = o->pos[(*n)->ind];
+        t = (max < 0 || p + max >= o->n) ? o->n - 1 : p + max;
+        *n = o->v[t];
+
+        return t - p;
+}
+
+
+/* Same as traverse_back(), but in this order */
+int order_traverse_back(struct commit_order *o, struct commit_node **n,
+                        int max)
+{
+        int p, t;
+
+        p = o->pos[(*n)->ind];
+        t = (max < 0 || p - max < 0) ? 0 : p - max;
+        *n = o->v[t];
+
+        return p - t;
+}
@@ -0,0 +1,49 @@
+/* order.h - Browsing the commits in an order other than git log's
+ * gitdiff contributors, 2026
+ *
+ * An order is a permutation of the list: the commits in the order they
+ * should be shown, and where each commit (by its index) landed. The list
+ * itself and the commits' indexes are left alone, so FROM..TO still means
+ * what it does in git log order.
+ */
+
+#ifndef ORDER_H
+#define ORDER_H
+
+#include "commitlist.h"
+
+
+enum {
+        ORDER_LOG = 0,
+        ORDER_AUTHOR,
+        ORDER_DATE,
+        ORDER_MESSAGE,
+        ORDER_COUNT
+};
+
+
+struct commit_order {
+        int mode;
+        struct commit_node **v;         /* Commits in display order */
+        int *pos;                       /* Indexed by commit_node.ind, -1
+                                           if filtered out */
+        int n;
+        int count;                      /* Length of pos */
+};
+
+
+extern char *ORDER_NAMES[ORDER_COUNT];
+
+struct commit_order *new_commit_order(commit_list cl, int mode);
+struct commit_order *copy_commit_order(struct commit_order *o);
+void free_commit_order(struct commit_order *o);
+void order_filter(struct commit_order *o, 
+                  int (*keep)(struct commit_node *n, void *arg), void *arg);
+int order_traverse_forward(struct commit_order *o, struct commit_node **n,
+                           int max);
+int order_traverse_back(struct commit_order *o, struct commit_node **n,
+                        int max);
+
+
+
+#endif
@@ -0,0 +1,42 @@
+/* parallel.c - Splitting work between threads
+ * gitdiff contributors, 2026
+ */
+
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "parallel.h"
+
+
+int cpu_count()
+{
+        long ncpu;
+
+        ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+        return (ncpu > 0) ? ncpu : 1;
+}
+
+
+/* Calls f on each of the n elements of args (each size bytes), one thread
+ * per element, and waits for them all. The first runs on the calling
+ * thread, as does any that a thread couldn't be started for.
+ */
+void run_parallel(void *(*f)(void*), void *args, size_t size, int n)
+{
+        pthread_t *th;
+        char *a;
+        int i, started;
+
+        a = (char*)args;
+        th = (pthread_t*)malloc(n * sizeof(*th));
+        for (started = 1; started < n; started++)
+                if (pthread_create(&th[started], NULL, f, a + started * size))
+                        break;
+        for (i = started; i < n; i++)
+                f(a + i * size);
+        if (n > 0)
+                f(a);
+        for (i = 1; i < started; i++)
+                pthread_join(th[i], NULL);
+        free(th);
+}
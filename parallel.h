@@ -0,0 +1,16 @@
+/* parallel.h - Splitting work between threads
+ * gitdiff contributors, 2026
+ */
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <stddef.h>
+
+
+int cpu_count();
+void run_parallel(void *(*f)(void*), void *args, size_t size, int n);
+
+
+
+#endif
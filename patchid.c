@@ -0,0 +1,401 @@
+/* patchid.c - Spotting commits that make the same change
+ * gitdiff contributors, 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "patchid.h"
+#include "gitcmd.h"
+
+#define FNV_OFFSET      0xcbf29ce484222325ULL
+#define FNV_PRIME       0x100000001b3ULL
+#define MAX_LINE        4096
+
+/* First line of the cache file. Bump it when the hash changes. */
+#define CACHE_HEADER    "# gitdiff patch-ids 2"
+
+
+struct pid_result {
+        struct commit_node *n;
+        uint64_t id;
+        int ok;
+};
+
+
+static uint64_t fnv_add(uint64_t h, const char *s, size_t len)
+{
+        size_t i;
+
+        for (i = 0; i < len; i++) {
+                /* Whitespace never counts */
+                if (s[i] == ' ' || s[i] == '\t' || s[i] == '\n' 
+                    || s[i] == '\r')
+                        continue;
+                h = (h ^ (unsigned char)s[i]) * FNV_PRIME;
+        }
+
+        return h;
+}
+
+
+/* Header lines that describe a file diff with no hunks: binary files,
+ * mode changes, empty files
+ */
+static int is_meta_line(const char *line)
+{
+        return !strncmp(line, "index ", 6) || !strncmp(line, "old mode ", 9)
+               || !strncmp(line, "new mode ", 9)
+               || !strncmp(line, "new file mode ", 14)
+               || !strncmp(line, "deleted file mode ", 18);
+}
+
+
+/* Hashes the changes in n. The paths from each "diff --git" line and the
+ * added and removed lines go in; hunk headers and context don't. A file
+ * with no hunks has nothing else to tell it apart, so its index line (with
+ * full blob ids) and mode lines go in instead, as git patch-id does.
+ * Returns 0 if git failed.
+ */
+static int compute_patchid(const char *dir, struct commit_node *n, 
+                           uint64_t *id)
+{
+        char hex[COMMIT_HEX_MAX_SIZE + 1], line[MAX_LINE];
+        char *args[] = { "diff-tree", "-p", "-r", "--root", "--no-commit-id",
+                         "--no-color", "--no-ext-diff", "--full-index", 
+                         hex, NULL };
+        uint64_t total, fh, mh;
+        int bol, hashing, inhunk, infile;
+        size_t len;
+        FILE *f;
+        pid_t pid;
+
+        hash_to_hex(n->hash, n->hashlen, hex);
+        if (!(f = git_popen(dir, args, &pid)))
+                return 0;
+        total = 0;
+        fh = mh = FNV_OFFSET;
+        bol = 1;
+        hashing = inhunk = infile = 0;
+        while (fgets(line, sizeof(line), f)) {
+                len = strlen(line);
+                if (bol) {
+                        if (!strncmp(line, "diff --git ", 11)) {
+                                if (infile)
+                                        total += inhunk ? fh : mh;
+                                fh = fnv_add(FNV_OFFSET, line + 11, len - 11);
+                                mh = fh;
+                                infile = 1;
+                                inhunk = hashing = 0;
+                        } else if (!strncmp(line, "@@", 2)) {
+                                inhunk = 1;
+                                hashing = 0;
+                        } else if (!inhunk && is_meta_line(line)) {
+                                mh = fnv_add(mh, line, len);
+                        } else {
+                                hashing = inhunk 
+                                          && (line[0] == '+' || line[0] == '-');
+                                if (hashing)
+                                        fh = fnv_add(fh, line, len);
+                        }
+                } else if (hashing) {
+                        /* The rest of a line longer than the buffer */
+                        fh = fnv_add(fh, line, len);
+                }
+                bol = (len && line[len - 1] == '\n');
+        }
+        if (infile)
+                total += inhunk ? fh : mh;
+        if (git_pclose(f, pid) != 0)
+                return 0;
+        *id = (infile && total == PATCHID_NONE) ? 1 : total;
+
+        return 1;
+}
+
+
+static void *patchid_worker(void *arg)
+{
+        struct patchid_pool *pp = (struct patchid_pool*)arg;
+        struct pid_result r;
+        sigset_t pipe;
+
+        /* Find out the main thread is gone from EPIPE, not a signal that
+         * would kill the process
+         */
+        sigemptyset(&pipe);
+        sigaddset(&pipe, SIGPIPE);
+        pthread_sigmask(SIG_BLOCK, &pipe, NULL);
+        for (;;) {
+                pthread_mutex_lock(&pp->lock);
+                while (!pp->stop && pp->qhead == pp->qlen)
+                        pthread_cond_wait(&pp->more, &pp->lock);
+                if (pp->stop) {
+                        pthread_mutex_unlock(&pp->lock);
+                        break;
+                }
+                r.n = pp->queue[pp->qhead++];
+                pthread_mutex_unlock(&pp->lock);
+
+                r.id = PATCHID_NONE;
+                r.ok = compute_patchid(pp->dir, r.n, &r.id);
+                /* Small enough to go down the pipe in one piece */
+                if (write(pp->resfd[1], &r, sizeof(r)) != sizeof(r))
+                        break;
+        }
+
+        return NULL;
+}
+
+
+static unsigned long hash_slot(const unsigned char *hash, int len, int size)
+{
+        unsigned long k = 0;
+
+        memcpy(&k, hash, (len < (int)sizeof(k)) ? len : sizeof(k));
+        return k & (size - 1);
+}
+
+
+static struct pid_entry *find_id(struct patchid_pool *pp, 
+                                 const unsigned char *hash, int len)
+{
+        struct pid_entry *e;
+        unsigned long i;
+
+        for (i = hash_slot(hash, len, pp->idsize); ; 
+             i = (i + 1) & (pp->idsize - 1)) {
+                e = &pp->ids[i];
+                if (!e->hashlen 
+                    || (e->hashlen == len && !memcmp(e->hash, hash, len)))
+                        return e;
+        }
+}
+
+
+static void add_id(struct patchid_pool *pp, const unsigned char *hash, 
+                   int len, uint64_t id)
+{
+        struct pid_entry *old, *e;
+        int i, oldsize;
+
+        if ((pp->nids + 1) * 2 > pp->idsize) {
+                old = pp->ids;
+                oldsize = pp->idsize;
+                pp->idsize *= 2;
+                pp->ids = (struct pid_entry*)calloc(pp->idsize, sizeof(*e));
+                for (i = 0; i < oldsize; i++)
+                        if (old[i].hashlen)
+                                *find_id(pp, old[i].hash, old[i].hashlen) 
+                                        = old[i];
+                free(old);
+        }
+        e = find_id(pp, hash, len);
+        if (!e->hashlen)
+                pp->nids++;
+        e->hashlen = len;
+        memcpy(e->hash, hash, len);
+        e->id = id;
+}
+
+
+static struct pid_count *find_count(struct patchid_pool *pp, uint64_t id)
+{
+        unsigned long i;
+
+        for (i = id & (pp->countsize - 1); 
+             pp->counts[i].id && pp->counts[i].id != id;
+             i = (i + 1) & (pp->countsize - 1))
+                ;
+        return &pp->counts[i];
+}
+
+
+static void count_id(struct patchid_pool *pp, uint64_t id)
+{
+        struct pid_count *old, *c;
+        int i, oldsize;
+
+        if (id == PATCHID_NONE)
+                return;
+        if ((pp->ncounts + 1) * 2 > pp->countsize) {
+                old = pp->counts;
+                oldsize = pp->countsize;
+                pp->countsize *= 2;
+                pp->counts = (struct pid_count*)calloc(pp->countsize, 
+                                                       sizeof(*c));
+                for (i = 0; i < oldsize; i++)
+                        if (old[i].id)
+                                *find_count(pp, old[i].id) = old[i];
+                free(old);
+        }
+        c = find_count(pp, id);
+        if (!c->id) {
+                c->id = id;
+                pp->ncounts++;
+        }
+        c->count++;
+}
+
+
+/* Returns 0 if f is from a version that hashed differently */
+static int load_cache(struct patchid_pool *pp, FILE *f)
+{
+        char hex[COMMIT_HEX_MAX_SIZE + 1], hdr[64];
+        unsigned char hash[COMMIT_HASH_MAX_SIZE];
+        unsigned long long id;
+        int len;
+
+        if (!fgets(hdr, sizeof(hdr), f) || strcmp(hdr, CACHE_HEADER "\n"))
+                return 0;
+        while (fscanf(f, "%64s %llx", hex, &id) == 2) {
+                len = hex_to_hash(hex, hash, sizeof(hash));
+                if (len && !(len % 2) && !hex[len])
+                        add_id(pp, hash, len / 2, id);
+        }
+
+        return 1;
+}
+
+
+/* Starts nthreads workers that run git in dir. cachepath may be NULL. */
+struct patchid_pool *new_patchid_pool(const char *dir, const char *cachepath,
+                                      int nthreads)
+{
+        struct patchid_pool *pp;
+        FILE *f;
+        int i, valid;
+
+        pp = (struct patchid_pool*)calloc(1, sizeof(struct patchid_pool));
+        if (pipe(pp->resfd) < 0) {
+                free(pp);
+                return NULL;
+        }
+        fcntl(pp->resfd[0], F_SETFL, O_NONBLOCK);
+        fcntl(pp->resfd[0], F_SETFD, FD_CLOEXEC);
+        fcntl(pp->resfd[1], F_SETFD, FD_CLOEXEC);
+        snprintf(pp->dir, sizeof(pp->dir), "%s", dir);
+
+        pp->idsize = pp->countsize = 1024;
+        pp->ids = (struct pid_entry*)calloc(pp->idsize, sizeof(*pp->ids));
+        pp->counts = (struct pid_count*)calloc(pp->countsize, 
+                                               sizeof(*pp->counts));
+        valid = 0;
+        if (cachepath && (f = fopen(cachepath, "r"))) {
+                valid = load_cache(pp, f);
+                fclose(f);
+        }
+        if (cachepath 
+            && (pp->cachef = fopen(cachepath, valid ? "a" : "w")) && !valid)
+                fprintf(pp->cachef, "%s\n", CACHE_HEADER);
+
+        pthread_mutex_init(&pp->lock, NULL);
+        pthread_cond_init(&pp->more, NULL);
+        pp->th = (pthread_t*)malloc(nthreads * sizeof(pthread_t));
+        for (i = 0; i < nthreads; i++)
+                if (!pthread_create(&pp->th[pp->nth], NULL, patchid_worker, 
+                                    pp))
+                        pp->nth++;
+
+        return pp;
+}
+
+
+void free_patchid_pool(struct patchid_pool *pp)
+{
+        int i;
+
+        if (!pp)
+                return;
+        pthread_mutex_lock(&pp->lock);
+        pp->stop = 1;
+        pthread_cond_broadcast(&pp->more);
+        pthread_mutex_unlock(&pp->lock);
+        /* Unblocks any worker stuck writing to a full pipe */
+        close(pp->resfd[0]);
+        for (i = 0; i < pp->nth; i++)
+                pthread_join(pp->th[i], NULL);
+        close(pp->resfd[1]);
+        if (pp->cachef)
+                fclose(pp->cachef);
+        pthread_mutex_destroy(&pp->lock);
+        pthread_cond_destroy(&pp->more);
+        free(pp->th);
+        free(pp->queue);
+        free(pp->ids);
+        free(pp->counts);
+        free(pp);
+}
+
+
+/* Asks for n's patch-id. Cached ones are counted straight away. */
+void patchid_enqueue(struct patchid_pool *pp, struct commit_node *n)
+{
+        struct pid_entry *e;
+
+        e = find_id(pp, n->hash, n->hashlen);
+        if (e->hashlen) {
+                count_id(pp, e->id);
+                return;
+        }
+        pthread_mutex_lock(&pp->lock);
+        if (pp->qlen == pp->qsize) {
+                pp->qsize = pp->qsize ? pp->qsize * 2 : 1024;
+                pp->queue = (struct commit_node**)realloc(pp->queue, 
+                                pp->qsize * sizeof(*pp->queue));
+        }
+        pp->queue[pp->qlen++] = n;
+        pthread_cond_signal(&pp->more);
+        pthread_mutex_unlock(&pp->lock);
+}
+
+
+/* Files away whatever the workers have finished. Call it when the pipe is
+ * readable; returns how many results there were.
+ */
+int patchid_collect(struct patchid_pool *pp)
+{
+        char hex[COMMIT_HEX_MAX_SIZE + 1];
+        struct pid_result r;
+        int c;
+
+        for (c = 0; read(pp->resfd[0], &r, sizeof(r)) == sizeof(r); c++) {
+                if (!r.ok)
+                        continue;
+                add_id(pp, r.n->hash, r.n->hashlen, r.id);
+                count_id(pp, r.id);
+                if (pp->cachef) {
+                        hash_to_hex(r.n->hash, r.n->hashlen, hex);
+                        fprintf(pp->cachef, "%s %016llx\n", hex, 
+                                (unsigned long long)r.id);
+                }
+        }
+        if (c && pp->cachef)
+                fflush(pp->cachef);
+
+        return c;
+}
+
+
+/* Returns 1 and sets id if n's patch-id is known */
+int commit_patchid(struct patchid_pool *pp, struct commit_node *n, 
+                   uint64_t *id)
+{
+        struct pid_entry *e;
+
+        e = find_id(pp, n->hash, n->hashlen);
+        if (!e->hashlen)
+                return 0;
+        *id = e->id;
+        return 1;
+}
+
+
+/* How many of the loaded commits are known to have this patch-id */
+int patchid_count(struct patchid_pool *pp, uint64_t id)
+{
+        return (id == PATCHID_NONE) ? 0 : find_count(pp, id)->count;
+}
@@ -0,0 +1,74 @@
+/* patchid.h - Spotting commits that make the same change
+ * gitdiff contributors, 2026
+ *
+ * A pool of worker threads runs git diff-tree on the loaded commits and
+ * hashes the changes with whitespace and line numbers left out, much like
+ * git patch-id --stable, so a commit and its cherry-picks or rebased copies
+ * come out the same. Each file's lines are hashed separately and the
+ * results summed, so the order of files in the diff doesn't matter.
+ *
+ * Results are cached by commit hash, in memory and in a file in the git
+ * directory, so each commit is only ever diffed once. Workers hand results
+ * to the main thread through a pipe; patchid_collect() files them away.
+ */
+
+#ifndef PATCHID_H
+#define PATCHID_H
+
+#include <stdint.h>
+#include <limits.h>
+#include <pthread.h>
+#include "commitlist.h"
+
+
+/* A commit_node that has no changes to hash (a merge, say) gets this */
+#define PATCHID_NONE    0
+
+
+struct pid_entry {
+        uint64_t id;
+        unsigned char hashlen;
+        unsigned char hash[COMMIT_HASH_MAX_SIZE];
+};
+
+
+struct pid_count {
+        uint64_t id;
+        int count;
+};
+
+
+struct patchid_pool {
+        char dir[PATH_MAX];
+        FILE *cachef;
+
+        /* Commit hash -> patch-id, for everything computed or cached */
+        struct pid_entry *ids;
+        int nids, idsize;
+        /* Patch-id -> how many loaded commits have it */
+        struct pid_count *counts;
+        int ncounts, countsize;
+
+        pthread_mutex_t lock;
+        pthread_cond_t more;
+        struct commit_node **queue;
+        int qhead, qlen, qsize;
+        int stop;
+        pthread_t *th;
+        int nth;
+        int resfd[2];
+};
+
+
+struct patchid_pool *new_patchid_pool(const char *dir, const char *cachepath,
+                                      int nthreads);
+void free_patchid_pool(struct patchid_pool *pp);
+void patchid_enqueue(struct patchid_pool *pp, struct commit_node *n);
+int patchid_collect(struct patchid_pool *pp);
+int commit_patchid(struct patchid_pool *pp, struct commit_node *n, 
+                   uint64_t *id);
+int patchid_count(struct patchid_pool *pp, uint64_t id);
+
+
+
+#endif
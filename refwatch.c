@@ -0,0 +1,183 @@
+/* refwatch.c - Noticing new commits while gitdiff is open
+ * gitdiff contributors, 2026
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/inotify.h>
+#include "refwatch.h"
+#include "gitcmd.h"
+
+#define REF_EVENTS      (IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE | IN_CREATE)
+
+
+/* Watches path and every directory below it */
+static void watch_tree(int fd, const char *path)
+{
+        char sub[PATH_MAX];
+        struct dirent *de;
+        DIR *d;
+
+        if (inotify_add_watch(fd, path, REF_EVENTS | IN_ONLYDIR) < 0)
+                return;
+        if (!(d = opendir(path)))
+                return;
+        while ((de = readdir(d))) {
+                if (de->d_type != DT_DIR || de->d_name[0] == '.')
+                        continue;
+                if (snprintf(sub, sizeof(sub), "%s/%s", path, de->d_name) 
+                    < (int)sizeof(sub))
+                        watch_tree(fd, sub);
+        }
+        closedir(d);
+}
+
+
+/* Returns NULL if dir isn't in a git repository, HEAD isn't tip, or
+ * inotify isn't there
+ */
+struct ref_watch *new_ref_watch(const char *dir, struct commit_node *tip)
+{
+        static char *gitdir[] = { "rev-parse", "--absolute-git-dir", NULL };
+        static char *commondir[] = { "rev-parse", "--path-format=absolute", 
+                                     "--git-common-dir", NULL };
+        static char *head[] = { "rev-parse", "HEAD", NULL };
+        char hex[COMMIT_HEX_MAX_SIZE + 1], hbuf[COMMIT_HEX_MAX_SIZE + 2];
+        struct ref_watch *rw;
+        char refs[PATH_MAX + sizeof("/refs")];
+
+        if (strlen(dir) >= sizeof(rw->dir))
+                return NULL;
+        hash_to_hex(tip->hash, tip->hashlen, hex);
+        if (!git_output_line(dir, head, hbuf, sizeof(hbuf)) 
+            || strcmp(hbuf, hex))
+                return NULL;
+        rw = (struct ref_watch*)malloc(sizeof(struct ref_watch));
+        strcpy(rw->head, hex);
+        if (!git_output_line(dir, gitdir, rw->gitdir, sizeof(rw->gitdir))) {
+                free(rw);
+                return NULL;
+        }
+        /* Older gits can't tell us; that's only a problem for worktrees */
+        if (!git_output_line(dir, commondir, rw->commondir, 
+                             sizeof(rw->commondir)))
+                strcpy(rw->commondir, rw->gitdir);
+        strcpy(rw->dir, dir);
+
+        if ((rw->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) < 0) {
+                free(rw);
+                return NULL;
+        }
+        rw->hdwd = inotify_add_watch(rw->fd, rw->gitdir, REF_EVENTS);
+        rw->cdwd = inotify_add_watch(rw->fd, rw->commondir, REF_EVENTS);
+        snprintf(refs, sizeof(refs), "%s/refs", rw->commondir);
+        watch_tree(rw->fd, refs);
+
+        return rw;
+}
+
+
+void free_ref_watch(struct ref_watch *rw)
+{
+        if (!rw)
+                return;
+        close(rw->fd);
+        free(rw);
+}
+
+
+static int ends_with(const char *s, const char *sfx)
+{
+        size_t ls = strlen(s), lf = strlen(sfx);
+
+        return ls >= lf && !strcmp(s + ls - lf, sfx);
+}
+
+
+/* Reads the pending events and says whether any of them could have moved
+ * HEAD. New directories under refs/ get watched as they show up.
+ */
+int ref_watch_changed(struct ref_watch *rw)
+{
+        char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+        const struct inotify_event *ev;
+        char refs[PATH_MAX + sizeof("/refs")], *p;
+        ssize_t len;
+        int changed;
+
+        changed = 0;
+        while ((len = read(rw->fd, buf, sizeof(buf))) > 0) {
+                for (p = buf; p < buf + len; 
+                     p += sizeof(struct inotify_event) + ev->len) {
+                        ev = (const struct inotify_event*)p;
+                        if (!ev->len || ends_with(ev->name, ".lock"))
+                                continue;
+                        if (ev->wd == rw->hdwd || ev->wd == rw->cdwd) {
+                                if (!strcmp(ev->name, "HEAD") 
+                                    || !strcmp(ev->name, "packed-refs"))
+                                        changed = 1;
+                                continue;
+                        }
+                        /* Anything else is somewhere under refs/ */
+                        if ((ev->mask & IN_ISDIR) && (ev->mask & IN_CREATE)) {
+                                snprintf(refs, sizeof(refs), "%s/refs", 
+                                         rw->commondir);
+                                watch_tree(rw->fd, refs);
+                        }
+                        changed = 1;
+                }
+        }
+
+        return changed;
+}
+
+
+/* Returns the commits HEAD has gained since it was last looked at, newest
+ * first, numbered from 0. NULL if there aren't any or git couldn't tell us.
+ * If HEAD no longer has the old HEAD in its history (a branch switch, reset
+ * or rewrite), the new commits can't just go on top of the list, so count
+ * is set to -1.
+ */
+commit_list fetch_new_commits(struct ref_watch *rw, struct commit_node **tail,
+                              int *count)
+{
+        static char *head[] = { "rev-parse", "HEAD", NULL };
+        char *log[] = { "log", "--pretty=medium", "--no-color", 
+                        "--decorate=no", NULL, NULL };
+        char *ancestor[] = { "merge-base", "--is-ancestor", NULL, NULL, NULL };
+        char hbuf[COMMIT_HEX_MAX_SIZE + 2], range[COMMIT_HEX_MAX_SIZE * 2 + 4];
+        commit_list cl;
+        FILE *f;
+        pid_t pid;
+
+        *tail = NULL;
+        *count = 0;
+        if (!git_output_line(rw->dir, head, hbuf, sizeof(hbuf)) 
+            || !strcmp(hbuf, rw->head))
+                return NULL;
+        ancestor[2] = rw->head;
+        ancestor[3] = hbuf;
+        if (git_status(rw->dir, ancestor) != 0) {
+                *count = -1;
+                return NULL;
+        }
+        snprintf(range, sizeof(range), "%s..%s", rw->head, hbuf);
+        log[4] = range;
+        if (!(f = git_popen(rw->dir, log, &pid)))
+                return NULL;
+        cl = parse_commit_list(f);
+        if (git_pclose(f, pid) != 0) {
+                free_commit_list(&cl);
+                return NULL;
+        }
+        strcpy(rw->head, hbuf);
+        for (*tail = cl; *tail && (*tail)->next; *tail = (*tail)->next)
+                ;
+        *count = commit_list_count(cl);
+
+        return cl;
+}
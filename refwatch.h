@@ -0,0 +1,39 @@
+/* refwatch.h - Noticing new commits while gitdiff is open
+ * gitdiff contributors, 2026
+ *
+ * Watches HEAD, packed-refs and everything under refs/ with inotify. When
+ * one of them changes, fetch_new_commits() asks git for whatever HEAD has
+ * now that it didn't have the last time we looked.
+ *
+ * That's only right if the list is HEAD's plain history, so a watch is only
+ * set up when the list's newest commit is HEAD. A log of another branch, or
+ * one filtered by author or path, usually won't start at HEAD; one that does
+ * by chance will have new commits added to it unfiltered.
+ */
+
+#ifndef REFWATCH_H
+#define REFWATCH_H
+
+#include <limits.h>
+#include "commitlist.h"
+
+
+struct ref_watch {
+        int fd;
+        char dir[PATH_MAX];             /* Work tree, where git is run */
+        char gitdir[PATH_MAX];
+        char commondir[PATH_MAX];       /* Where refs/ lives */
+        int hdwd, cdwd;                 /* Watches on gitdir, commondir */
+        char head[COMMIT_HEX_MAX_SIZE + 1];     /* HEAD when last fetched */
+};
+
+
+struct ref_watch *new_ref_watch(const char *dir, struct commit_node *tip);
+void free_ref_watch(struct ref_watch *rw);
+int ref_watch_changed(struct ref_watch *rw);
+commit_list fetch_new_commits(struct ref_watch *rw, struct commit_node **tail,
+                              int *count);
+
+
+
+#endif
@@ -0,0 +1,139 @@
+/* rowcache.c - Formatted list rows, kept between redraws
+ * gitdiff contributors, 2026
+ */
+
+#define _XOPEN_SOURCE 700
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#include "rowcache.h"
+
+#define CMT_INDENT      4
+
+
+struct row_cache *new_row_cache()
+{
+        struct row_cache *rc;
+
+        rc = (struct row_cache*)calloc(1, sizeof(struct row_cache));
+        rc->w = -1;
+        invalidate_row_cache(rc);
+
+        return rc;
+}
+
+
+void free_row_cache(struct row_cache *rc)
+{
+        if (!rc)
+                return;
+        invalidate_row_cache(rc);
+        free(rc);
+}
+
+
+/* Throws away every cached row */
+void invalidate_row_cache(struct row_cache *rc)
+{
+        struct row_render *rr;
+        int i;
+
+        for (i = 0; i < ROW_CACHE_SIZE; i++) {
+                rr = &rc->rows[i];
+                free(rr->hdr);
+                free(rr->cmt);
+                rr->hdr = rr->cmt = NULL;
+                rr->ind = -1;
+                rr->used = 0;
+        }
+}
+
+
+/* The slot for commit ind: where it already is, or else the least recently
+ * used one in its set, emptied
+ */
+static struct row_render *find_row(struct row_cache *rc, int ind)
+{
+        struct row_render *set, *lru;
+        int i;
+
+        set = &rc->rows[(ind % (ROW_CACHE_SIZE / ROW_CACHE_WAYS)) 
+                        * ROW_CACHE_WAYS];
+        lru = set;
+        for (i = 0; i < ROW_CACHE_WAYS; i++) {
+                if (set[i].ind == ind)
+                        return &set[i];
+                if (set[i].used < lru->used)
+                        lru = &set[i];
+        }
+        free(lru->hdr);
+        free(lru->cmt);
+        lru->hdr = lru->cmt = NULL;
+        lru->ind = ind;
+
+        return lru;
+}
+
+
+/* Returns a copy of the longest prefix of s taking up at most cols columns */
+char *fit_width(const char *s, int cols)
+{
+        mbstate_t mbs;
+        wchar_t wc;
+        size_t len, l;
+        int w, cw;
+        char *ret;
+
+        memset(&mbs, 0, sizeof(mbs));
+        for (len = 0, w = 0; s[len]; len += l, w += cw) {
+                l = mbrtowc(&wc, s + len, MB_CUR_MAX, &mbs);
+                if (l == (size_t)-1 || l == (size_t)-2) {
+                        /* Not valid in this locale, show it a byte at a time */
+                        memset(&mbs, 0, sizeof(mbs));
+                        l = 1;
+                        cw = 1;
+                } else if ((cw = wcwidth(wc)) < 0) {
+                        cw = 1;
+                }
+                if (w + cw > cols)
+                        break;
+        }
+        ret = (char*)malloc(len + 1);
+        memcpy(ret, s, len);
+        ret[len] = '\0';
+
+        return ret;
+}
+
+
+struct row_render *get_row_render(struct row_cache *rc, struct commit_node *cn,
+                                  int w)
+{
+        struct row_render *rr;
+        const char *cmt;
+        char *hbuf;
+        int hsize;
+
+        if (w != rc->w) {
+                invalidate_row_cache(rc);
+                rc->w = w;
+        }
+        if (cn->ind < 0)
+                return NULL;
+        rr = find_row(rc, cn->ind);
+        rr->used = ++rc->clock;
+        if (!rr->hdr) {
+                hsize = (cn->date ? strlen(cn->date) : 0) 
+                        + (cn->author ? strlen(cn->author) : 0) + 4;
+                hbuf = (char*)malloc(hsize);
+                snprintf(hbuf, hsize, "%s | %s", cn->date ? cn->date : "", 
+                         cn->author ? cn->author : "");
+                rr->hdr = fit_width(hbuf, w);
+                cmt = commit_comment(cn);
+                rr->cmt = fit_width(cmt ? cmt : "", w - CMT_INDENT);
+                free(hbuf);
+        }
+
+        return rr;
+}
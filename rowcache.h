@@ -0,0 +1,51 @@
+/* rowcache.h - Formatted list rows, kept between redraws
+ * gitdiff contributors, 2026
+ *
+ * Each commit takes two rows in the list: "date | author" and the comment.
+ * Both are formatted and cut to the list width the first time the commit is
+ * drawn and then reused until the width changes or the data does, so
+ * scrolling back over rows that have been shown does no formatting at all.
+ * Only the ROW_CACHE_SIZE most recently drawn commits are kept, which is
+ * several screens' worth, so the cache costs the same however long the
+ * history is.
+ * Widths are measured in screen columns, not bytes, so multibyte authors and
+ * double-width characters are cut in the right place.
+ */
+
+#ifndef ROWCACHE_H
+#define ROWCACHE_H
+
+#include "commitlist.h"
+
+/* Rows are kept in sets of ROW_CACHE_WAYS picked by commit index, the least
+ * recently drawn in a set making way for a new one
+ */
+#define ROW_CACHE_SIZE  1024
+#define ROW_CACHE_WAYS  4
+
+
+struct row_render {
+        char *hdr;
+        char *cmt;
+        int ind;                        /* -1 when empty */
+        unsigned int used;
+};
+
+
+struct row_cache {
+        struct row_render rows[ROW_CACHE_SIZE];
+        int w;
+        unsigned int clock;
+};
+
+
+struct row_cache *new_row_cache();
+void free_row_cache(struct row_cache *rc);
+void invalidate_row_cache(struct row_cache *rc);
+char *fit_width(const char *s, int cols);
+struct row_render *get_row_render(struct row_cache *rc, struct commit_node *cn,
+                                  int w);
+
+
+
+#endif
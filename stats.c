@@ -0,0 +1,255 @@
+/* stats.c - Commit counts by author and by date
+ * gitdiff contributors, 2026
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "stats.h"
+#include "parallel.h"
+
+/* Below this many commits a range is counted on the calling thread */
+#define MIN_PART_SIZE   (64 * 1024)
+
+
+struct stats_part {
+        struct commit_stats *cs;
+        int lo, hi;
+        int sign;
+        int *acount, *dcount, *mcount;
+        int wday[7];
+        int total;
+        int dmin, dmax, mmin, mmax;
+};
+
+
+static int part_count(int n)
+{
+        int parts, ncpu;
+
+        ncpu = cpu_count();
+        parts = n / MIN_PART_SIZE + 1;
+        return (parts > ncpu) ? ncpu : parts;
+}
+
+
+static void split_parts(struct commit_stats *cs, struct stats_part *p, 
+                        int nparts, int lo, int hi)
+{
+        int i;
+
+        memset(p, 0, nparts * sizeof(*p));
+        for (i = 0; i < nparts; i++) {
+                p[i].cs = cs;
+                p[i].lo = lo + (long)(hi - lo) * i / nparts;
+                p[i].hi = lo + (long)(hi - lo) * (i + 1) / nparts;
+        }
+}
+
+
+static void *date_part(void *arg)
+{
+        struct stats_part *p = (struct stats_part*)arg;
+        struct commit_stats *cs = p->cs;
+        struct tm tm;
+        time_t t;
+        int i;
+
+        p->dmin = p->mmin = -1;
+        for (i = p->lo; i < p->hi; i++) {
+                if ((t = commit_time(cs->v[i]->date)) < 0) {
+                        cs->day[i] = cs->month[i] = -1;
+                        continue;
+                }
+                gmtime_r(&t, &tm);
+                cs->day[i] = t / (24 * 60 * 60);
+                cs->month[i] = (tm.tm_year + 1900) * 12 + tm.tm_mon;
+                if (p->dmin < 0 || cs->day[i] < p->dmin)
+                        p->dmin = cs->day[i];
+                if (cs->day[i] > p->dmax)
+                        p->dmax = cs->day[i];
+                if (p->mmin < 0 || cs->month[i] < p->mmin)
+                        p->mmin = cs->month[i];
+                if (cs->month[i] > p->mmax)
+                        p->mmax = cs->month[i];
+        }
+
+        return NULL;
+}
+
+
+static void *count_part(void *arg)
+{
+        struct stats_part *p = (struct stats_part*)arg;
+        struct commit_stats *cs = p->cs;
+        int i, d;
+
+        for (i = p->lo; i < p->hi; i++) {
+                p->acount[cs->at->ids[i]] += p->sign;
+                p->total += p->sign;
+                if ((d = cs->day[i]) < 0)
+                        continue;
+                p->dcount[d - cs->day0] += p->sign;
+                p->mcount[cs->month[i] - cs->month0] += p->sign;
+                /* The epoch was a Thursday */
+                p->wday[(d + 4) % 7] += p->sign;
+        }
+
+        return NULL;
+}
+
+
+/* Adds (sign 1) or removes (sign -1) the commits in [lo, hi) */
+static void count_range(struct commit_stats *cs, int lo, int hi, int sign)
+{
+        struct stats_part *p;
+        int nparts, i, j;
+
+        if (lo >= hi)
+                return;
+        nparts = part_count(hi - lo);
+        p = (struct stats_part*)malloc(nparts * sizeof(*p));
+        split_parts(cs, p, nparts, lo, hi);
+        if (nparts == 1) {
+                p[0].sign = sign;
+                p[0].acount = cs->acount;
+                p[0].dcount = cs->dcount;
+                p[0].mcount = cs->mcount;
+                count_part(&p[0]);
+                for (j = 0; j < 7; j++)
+                        cs->wday[j] += p[0].wday[j];
+                cs->total += p[0].total;
+                free(p);
+                return;
+        }
+
+        for (i = 0; i < nparts; i++) {
+                p[i].sign = 1;
+                p[i].acount = (int*)calloc(cs->at->n + 1, sizeof(int));
+                p[i].dcount = (int*)calloc(cs->nday + 1, sizeof(int));
+                p[i].mcount = (int*)calloc(cs->nmonth + 1, sizeof(int));
+        }
+        run_parallel(count_part, p, sizeof(*p), nparts);
+        for (i = 0; i < nparts; i++) {
+                for (j = 0; j < cs->at->n; j++)
+                        cs->acount[j] += sign * p[i].acount[j];
+                for (j = 0; j < cs->nday; j++)
+                        cs->dcount[j] += sign * p[i].dcount[j];
+                for (j = 0; j < cs->nmonth; j++)
+                        cs->mcount[j] += sign * p[i].mcount[j];
+                for (j = 0; j < 7; j++)
+                        cs->wday[j] += sign * p[i].wday[j];
+                cs->total += sign * p[i].total;
+                free(p[i].acount);
+                free(p[i].dcount);
+                free(p[i].mcount);
+        }
+        free(p);
+}
+
+
+/* The table starts out with nothing counted; see set_stats_range() */
+struct commit_stats *new_commit_stats(commit_list cl)
+{
+        struct commit_stats *cs;
+        struct stats_part *p;
+        int nparts, i, dmax, mmax;
+
+        cs = (struct commit_stats*)calloc(1, sizeof(struct commit_stats));
+        cs->v = commit_list_array(cl, &cs->n);
+        cs->at = new_author_tab(cs->v, cs->n);
+        cs->day = (int*)malloc((cs->n + 1) * sizeof(int));
+        cs->month = (int*)malloc((cs->n + 1) * sizeof(int));
+
+        nparts = part_count(cs->n);
+        p = (struct stats_part*)malloc(nparts * sizeof(*p));
+        split_parts(cs, p, nparts, 0, cs->n);
+        run_parallel(date_part, p, sizeof(*p), nparts);
+        cs->day0 = cs->month0 = -1;
+        dmax = mmax = 0;
+        for (i = 0; i < nparts; i++) {
+                if (p[i].dmin < 0)
+                        continue;
+                if (cs->day0 < 0 || p[i].dmin < cs->day0)
+                        cs->day0 = p[i].dmin;
+                if (cs->month0 < 0 || p[i].mmin < cs->month0)
+                        cs->month0 = p[i].mmin;
+                if (p[i].dmax > dmax)
+                        dmax = p[i].dmax;
+                if (p[i].mmax > mmax)
+                        mmax = p[i].mmax;
+        }
+        free(p);
+        cs->nday = (cs->day0 < 0) ? 0 : dmax - cs->day0 + 1;
+        cs->nmonth = (cs->month0 < 0) ? 0 : mmax - cs->month0 + 1;
+
+        cs->acount = (int*)calloc(cs->at->n + 1, sizeof(int));
+        cs->dcount = (int*)calloc(cs->nday + 1, sizeof(int));
+        cs->mcount = (int*)calloc(cs->nmonth + 1, sizeof(int));
+
+        return cs;
+}
+
+
+void free_commit_stats(struct commit_stats *cs)
+{
+        if (!cs)
+                return;
+        free_author_tab(cs->at);
+        free(cs->v);
+        free(cs->day);
+        free(cs->month);
+        free(cs->acount);
+        free(cs->dcount);
+        free(cs->mcount);
+        free(cs);
+}
+
+
+/* Moves the counted range to [lo, hi). If it overlaps the old one, only the
+ * commits at the ends that changed get counted.
+ */
+void set_stats_range(struct commit_stats *cs, int lo, int hi)
+{
+        if (lo < 0)
+                lo = 0;
+        if (hi > cs->n)
+                hi = cs->n;
+        if (hi < lo)
+                hi = lo;
+        if (lo >= cs->hi || hi <= cs->lo) {
+                count_range(cs, cs->lo, cs->hi, -1);
+                count_range(cs, lo, hi, 1);
+        } else {
+                count_range(cs, cs->lo, lo, -1);
+                count_range(cs, lo, cs->lo, 1);
+                count_range(cs, hi, cs->hi, -1);
+                count_range(cs, cs->hi, hi, 1);
+        }
+        cs->lo = lo;
+        cs->hi = hi;
+}
+
+
+/* Fills top with the indexes of the (up to) ntop largest counts, largest
+ * first. Returns how many were filled.
+ */
+int stats_top(int *counts, int n, int *top, int ntop)
+{
+        int i, j, k;
+
+        for (k = 0, i = 0; i < n; i++) {
+                if (counts[i] <= 0)
+                        continue;
+                for (j = k; j > 0 && counts[top[j - 1]] < counts[i]; j--)
+                        if (j < ntop)
+                                top[j] = top[j - 1];
+                if (j < ntop) {
+                        top[j] = i;
+                        if (k < ntop)
+                                k++;
+                }
+        }
+
+        return k;
+}
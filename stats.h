@@ -0,0 +1,42 @@
+/* stats.h - Commit counts by author and by date
+ * gitdiff contributors, 2026
+ *
+ * The counts are for the commits between two indexes of the list. They are
+ * computed by splitting the commits between threads, each counting into its
+ * own arrays, and summing the arrays at the end. When the range moves, only
+ * the commits that entered or left it are counted again.
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include "commitlist.h"
+#include "authors.h"
+
+
+struct commit_stats {
+        struct commit_node **v;         /* Indexed by commit_node.ind */
+        int n;
+        struct author_tab *at;
+        int *day;                       /* Days since the epoch, -1 if none */
+        int *month;                     /* year * 12 + month, -1 if none */
+        int day0, nday;
+        int month0, nmonth;
+
+        int lo, hi;                     /* Counted range, [lo, hi) */
+        int total;
+        int *acount;                    /* Per author id */
+        int *dcount;                    /* Per day, from day0 */
+        int *mcount;                    /* Per month, from month0 */
+        int wday[7];                    /* Sunday first */
+};
+
+
+struct commit_stats *new_commit_stats(commit_list cl);
+void free_commit_stats(struct commit_stats *cs);
+void set_stats_range(struct commit_stats *cs, int lo, int hi);
+int stats_top(int *counts, int n, int *top, int ntop);
+
+
+
+#endif